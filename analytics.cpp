@@ -0,0 +1,155 @@
+#include "analytics.h"
+#include <cmath>
+#include <functional>
+#include <chrono>
+
+// Each thread sticks to one stripe, handed out round-robin as threads first count
+static size_t threadStripe() {
+    static atomic<size_t> nextStripe{0};
+    thread_local size_t stripe = nextStripe.fetch_add(1, memory_order_relaxed) % StripedCounter::STRIPES;
+    return stripe;
+}
+
+// StripedCounter implementation
+StripedCounter::~StripedCounter() { delete[] stripes.load(memory_order_relaxed); }
+
+StripedCounter::Stripe* StripedCounter::inflate() {
+    Stripe* fresh = new Stripe[STRIPES];
+    Stripe* expected = nullptr;
+    if (stripes.compare_exchange_strong(expected, fresh, memory_order_acq_rel)) return fresh;
+    // Another thread inflated first; use its stripes
+    delete[] fresh;
+    return expected;
+}
+
+void StripedCounter::add(long long n) {
+    Stripe* s = stripes.load(memory_order_acquire);
+    if (!s) {
+        long long cur = base.load(memory_order_relaxed);
+        if (base.compare_exchange_strong(cur, cur + n, memory_order_relaxed)) return;
+        s = inflate();
+    }
+    s[threadStripe()].value.fetch_add(n, memory_order_relaxed);
+}
+
+long long StripedCounter::read() const {
+    long long total = base.load(memory_order_relaxed);
+    Stripe* s = stripes.load(memory_order_acquire);
+    if (s) {
+        for (size_t i = 0; i < STRIPES; ++i) total += s[i].value.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+bool StripedCounter::isStriped() const { return stripes.load(memory_order_relaxed) != nullptr; }
+
+// ViewTimeline implementation
+ViewTimeline::~ViewTimeline() { delete rings.load(memory_order_relaxed); }
+
+void ViewTimeline::bump(atomic<uint64_t>* ring, size_t size, uint32_t period, uint32_t views) {
+    atomic<uint64_t>& bucket = ring[period % size];
+    uint64_t cur = bucket.load(memory_order_relaxed);
+    while (true) {
+        uint32_t held = static_cast<uint32_t>(cur >> 32);
+        if (held == period) {
+            // A reset racing with this add can only move these views into the
+            // next period, right at the boundary
+            bucket.fetch_add(views, memory_order_relaxed);
+            return;
+        }
+        if (held > period) return;  // Bucket already reused for a later period
+        if (bucket.compare_exchange_weak(cur, (static_cast<uint64_t>(period) << 32) | views,
+                                         memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+long long ViewTimeline::sum(const atomic<uint64_t>* ring, size_t size, uint32_t period, size_t n) {
+    long long total = 0;
+    for (size_t i = 0; i < min(n, size) && i <= period; ++i) {
+        uint32_t p = period - static_cast<uint32_t>(i);
+        uint64_t bucket = ring[p % size].load(memory_order_relaxed);
+        if (static_cast<uint32_t>(bucket >> 32) == p) total += static_cast<uint32_t>(bucket);
+    }
+    return total;
+}
+
+void ViewTimeline::record(long long nowSec, long long views) {
+    Rings* r = rings.load(memory_order_acquire);
+    if (!r) {
+        Rings* fresh = new Rings();
+        if (rings.compare_exchange_strong(r, fresh, memory_order_acq_rel)) {
+            r = fresh;
+        } else {
+            delete fresh;  // Another thread got there first; r now holds its rings
+        }
+    }
+    uint32_t n = static_cast<uint32_t>(views);
+    bump(r->minutes, MINUTES, static_cast<uint32_t>(nowSec / 60), n);
+    bump(r->hours, HOURS, static_cast<uint32_t>(nowSec / 3600), n);
+    bump(r->days, DAYS, static_cast<uint32_t>(nowSec / 86400), n);
+}
+
+long long ViewTimeline::count(Resolution res, size_t n, long long nowSec) const {
+    Rings* r = rings.load(memory_order_acquire);
+    if (!r) return 0;
+    switch (res) {
+        case MINUTE: return sum(r->minutes, MINUTES, static_cast<uint32_t>(nowSec / 60), n);
+        case HOUR:   return sum(r->hours, HOURS, static_cast<uint32_t>(nowSec / 3600), n);
+        case DAY:    return sum(r->days, DAYS, static_cast<uint32_t>(nowSec / 86400), n);
+    }
+    return 0;
+}
+
+size_t ViewTimeline::bytes() const {
+    return sizeof(*this) + (rings.load(memory_order_relaxed) ? sizeof(Rings) : 0);
+}
+
+long long ViewTimeline::nowSeconds() {
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// HyperLogLog implementation
+void HyperLogLog::add(const string& item) {
+    // std::hash output isn't guaranteed to be well mixed in every bit, and the
+    // sketch reads the top bits, so run it through the splitmix64 finalizer
+    uint64_t h = hash<string>()(item);
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    addHash(h);
+}
+
+void HyperLogLog::addHash(uint64_t hash) {
+    // Top bits pick the register; it keeps the longest run of leading zeros
+    // (plus one) seen in the remaining bits
+    size_t index = hash >> (64 - PRECISION);
+    uint64_t rest = hash << PRECISION;
+    uint8_t rank = rest ? static_cast<uint8_t>(__builtin_clzll(rest) + 1) : 64 - PRECISION + 1;
+    if (rank > registers[index]) registers[index] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < REGISTERS; ++i) {
+        if (other.registers[i] > registers[i]) registers[i] = other.registers[i];
+    }
+}
+
+long long HyperLogLog::estimate() const {
+    double sum = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < REGISTERS; ++i) {
+        sum += ldexp(1.0, -registers[i]);
+        if (registers[i] == 0) ++zeros;
+    }
+    const double m = static_cast<double>(REGISTERS);
+    double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // Small counts leave registers empty; linear counting is more accurate there
+    if (e <= 2.5 * m && zeros > 0) e = m * log(m / zeros);
+    return llround(e);
+}
+
+size_t HyperLogLog::bytes() const { return sizeof(registers); }
@@ -0,0 +1,92 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Counter for hot paths that moves to per-thread stripes once two threads collide
+class StripedCounter {
+public:
+    static const size_t STRIPES = 16;
+
+private:
+    struct alignas(64) Stripe {
+        atomic<long long> value{0};
+    };
+    atomic<long long> base{0};
+    atomic<Stripe*> stripes{nullptr};  // Allocated on the first collision
+
+    Stripe* inflate();
+
+public:
+    StripedCounter() = default;
+    ~StripedCounter();
+    StripedCounter(const StripedCounter&) = delete;
+    StripedCounter& operator=(const StripedCounter&) = delete;
+
+    void add(long long n = 1);
+    // Exact once writers are done; while they run it may miss adds in flight
+    long long read() const;
+    bool isStriped() const;
+};
+
+// Recent views in minute, hour and day rings, recorded without locks
+class ViewTimeline {
+public:
+    enum Resolution { MINUTE, HOUR, DAY };
+    static const size_t MINUTES = 60;
+    static const size_t HOURS = 24;
+    static const size_t DAYS = 30;
+
+private:
+    struct Rings {
+        // High 32 bits: period number since the epoch; low 32 bits: views in it
+        atomic<uint64_t> minutes[MINUTES]{};
+        atomic<uint64_t> hours[HOURS]{};
+        atomic<uint64_t> days[DAYS]{};
+    };
+    atomic<Rings*> rings{nullptr};
+
+    static void bump(atomic<uint64_t>* ring, size_t size, uint32_t period, uint32_t views);
+    static long long sum(const atomic<uint64_t>* ring, size_t size, uint32_t period, size_t n);
+
+public:
+    ViewTimeline() = default;
+    ~ViewTimeline();
+    ViewTimeline(const ViewTimeline&) = delete;
+    ViewTimeline& operator=(const ViewTimeline&) = delete;
+
+    // Safe from any number of threads at once
+    void record(long long nowSec, long long views = 1);
+    // Views in the last n periods of the given size, the current one included.
+    // n is capped at the ring length.
+    long long count(Resolution r, size_t n, long long nowSec) const;
+    size_t bytes() const;
+
+    static long long nowSeconds();
+};
+
+// HyperLogLog sketch of distinct items, such as unique viewers
+class HyperLogLog {
+public:
+    // 2^PRECISION one-byte registers (4 KB) give about 1.6% standard error at any count
+    static const int PRECISION = 12;
+    static const size_t REGISTERS = size_t(1) << PRECISION;
+
+private:
+    uint8_t registers[REGISTERS] = {};
+
+public:
+    void add(const string& item);
+    void addHash(uint64_t hash);
+    // Lossless for equal precision, so a channel's audience is the union of its videos'
+    void merge(const HyperLogLog& other);
+    long long estimate() const;
+    size_t bytes() const;
+};
+
+#endif
@@ -0,0 +1,685 @@
+#include "bench.h"
+#include "user.h"
+#include "search.h"
+#include "textmatch.h"
+#include "trending.h"
+#include <functional>
+#include <thread>
+#include <random>
+#include <cmath>
+#include <cstdio>
+
+// Seconds one call of fn takes
+static double timeIt(const function<void()>& fn) {
+    auto t0 = chrono::steady_clock::now();
+    fn();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+// Seconds until work(t) has returned on every one of the threads
+static double timeThreads(unsigned threads, const function<void(unsigned)>& work) {
+    return timeIt([&]() {
+        vector<thread> workers;
+        for (unsigned t = 0; t < threads; ++t) workers.emplace_back(work, t);
+        for (thread& w : workers) w.join();
+    });
+}
+
+// 1, 2, 4, ... threads, up to the last power of two not above max
+static vector<unsigned> threadSteps(unsigned max) {
+    vector<unsigned> steps;
+    for (unsigned threads = 1; threads <= max; threads *= 2) steps.push_back(threads);
+    return steps;
+}
+
+// At least four, so contention shows even on small machines
+static unsigned benchThreads() { return max(4u, thread::hardware_concurrency()); }
+
+static string micros(double secs) { return to_string((long long)(secs * 1e6)) + " μs"; }
+
+static string nanosEach(double secs, double ops) { return to_string((long long)(secs * 1e9 / ops)) + " ns"; }
+
+// "12M plays/s", "450k likes/s", ...
+static string rate(double count, double secs, const string& unit) {
+    double perSec = count / max(secs, 1e-9);
+    if (perSec >= 1e7) return to_string((long long)(perSec / 1e6)) + "M " + unit + "/s";
+    if (perSec >= 1e4) return to_string((long long)(perSec / 1e3)) + "k " + unit + "/s";
+    return to_string((long long)perSec) + " " + unit + "/s";
+}
+
+// True if no value appears twice across all the lists
+static bool allDistinct(const vector<vector<long long>>& lists) {
+    vector<long long> all;
+    for (const auto& l : lists) all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    return adjacent_find(all.begin(), all.end()) == all.end();
+}
+
+// Silences per-call PerfTimers for a test's scope; they would flood the output
+class QuietPerf {
+private:
+    bool saved;
+public:
+    QuietPerf() : saved(PERF_LOGGING) { PERF_LOGGING = false; }
+    ~QuietPerf() { PERF_LOGGING = saved; }
+};
+
+// Test 1: Video lookup speed
+static void benchLookup(const VideoTable& videos) {
+    Video* first = videos.first();
+    if (!first) return;
+    VideoId id = first->getId();  // IDs need not start at 1, e.g. in snowflake mode
+    PerfTimer t("1000 video lookups");
+    for (int i = 0; i < 1000; ++i) {
+        volatile auto it = videos.find(id);
+        (void)it;  // Prevent compiler optimization
+    }
+}
+
+// Test 1b: 1000 random lookups over 100k videos, hash map vs dense table.
+// Fixtures here and below take explicit IDs so real uploads stay dense.
+static void benchLookupTable() {
+    const int VIDEOS = 100000, LOOKUPS = 1000, ROUNDS = 1000;
+    vector<unique_ptr<Video>> owned;
+    unordered_map<VideoId, Video*> byHash;
+    VideoTable byTable;
+    mt19937 rng(5);
+    for (int i = 0; i < VIDEOS; ++i) {
+        owned.push_back(make_unique<Video>(VideoId(i + 1), "Lookup " + to_string(i), "bench", 60));
+        byHash[owned.back()->getId()] = owned.back().get();
+        byTable.insert(owned.back().get());
+    }
+    vector<VideoId> ids;
+    for (int i = 0; i < LOOKUPS; ++i) ids.push_back(owned[rng() % VIDEOS]->getId());
+
+    long long sumHash = 0, sumTable = 0;
+    double hashSecs = timeIt([&]() {
+        for (int r = 0; r < ROUNDS; ++r) {
+            for (VideoId id : ids) sumHash += byHash.find(id)->second->getDuration();
+        }
+    });
+    double tableSecs = timeIt([&]() {
+        for (int r = 0; r < ROUNDS; ++r) {
+            for (VideoId id : ids) sumTable += byTable.find(id)->getDuration();
+        }
+    });
+    Logger::log(Logger::PERF, "1000 random lookups over 100000 videos: hash map " +
+                nanosEach(hashSecs, LOOKUPS * ROUNDS) + " per lookup, table " +
+                nanosEach(tableSecs, LOOKUPS * ROUNDS) + " per lookup" +
+                (sumHash == sumTable ? "" : " (RESULTS DIFFER)"));
+}
+
+// Test 2: Comment addition speed
+static void benchAddComments(const VideoTable& videos) {
+    Video* testVid = videos.first();
+    if (!testVid) return;
+    PerfTimer t("100 comment additions");
+    for (int i = 0; i < 100; ++i) testVid->addComment("benchuser", "test comment");
+}
+
+// Test 3: Search performance
+static void benchCatalogScan(const VideoTable& videos) {
+    PerfTimer t("Video search");
+    int count = 0;
+    videos.forEach([&](Video* v) {
+        if (containsIgnoreCase(v->getTitle(), "c++")) count++;
+    });
+    (void)count;
+}
+
+// Test 4: Title scan with a lowercase copy per title vs the in-place kernel
+static void benchTitleScan() {
+    vector<string> titles;
+    titles.reserve(100000);
+    for (int i = 0; i < 100000; ++i) {
+        titles.push_back("Episode " + to_string(i) + ": Modern C++ Templates and Concurrency");
+    }
+    string query = "rust";  // No title matches, so every byte gets examined
+    int copyHits = 0, kernelHits = 0;
+    {
+        PerfTimer t("Scan 100000 titles (copy + find)");
+        for (const auto &title : titles) {
+            string low = title;
+            transform(low.begin(), low.end(), low.begin(), ::tolower);
+            if (low.find(query) != string::npos) copyHits++;
+        }
+    }
+    {
+        PerfTimer t(string("Scan 100000 titles (") + textMatchKernel() + " kernel)");
+        for (const auto &title : titles) {
+            if (containsIgnoreCase(title, query)) kernelHits++;
+        }
+    }
+    Logger::log(Logger::PERF, "Scan matches: " + to_string(copyHits) +
+                " (copy) vs " + to_string(kernelHits) + " (kernel)");
+}
+
+// Test 5: Short-query scan on one thread vs split across catalog shards
+static void benchShardedScan() {
+    const int N = 100000;
+    vector<unique_ptr<Video>> owned;
+    SearchIndex bench;
+    owned.reserve(N);
+    for (int i = 0; i < N; ++i) {
+        owned.push_back(make_unique<Video>(VideoId(i + 1),
+            "Episode " + to_string(i) + ": Modern C++ Templates and Concurrency", "bench", 60));
+        bench.add(owned.back().get());
+    }
+
+    size_t threads = max(2u, thread::hardware_concurrency());
+    vector<SearchHit> single, sharded;
+    double singleSecs = timeIt([&]() { single = bench.searchRanked("te"); });
+    bench.setScanThreads(threads);
+    double shardedSecs = timeIt([&]() { sharded = bench.searchRanked("te"); });
+
+    bool same = single.size() == sharded.size();
+    for (size_t i = 0; same && i < single.size(); ++i) same = single[i].video == sharded[i].video;
+    Logger::log(Logger::PERF, "Scan 100000 videos, 1 thread: " + micros(singleSecs));
+    Logger::log(Logger::PERF, "Scan 100000 videos, " + to_string(threads) + " shards: " + micros(shardedSecs) +
+                " (speedup " + to_string(singleSecs / max(shardedSecs, 1e-6)).substr(0, 4) + "x, results " +
+                (same ? "match" : "DIFFER") + ")");
+}
+
+// Test 6: Top comments on a video with 1M comments
+static void benchTopComments() {
+    QuietPerf quiet;
+    const int N = 1000000;
+    Video big(VideoId(1), "Viral video", "bench", 60);
+    vector<CommentId> ids;
+    ids.reserve(N);
+    for (int i = 0; i < N; ++i) {
+        ids.push_back(CommentId(big.addComment("fan" + to_string(i % 1000), "comment " + to_string(i)).id));
+    }
+
+    // Skewed towards early comments, like real threads
+    mt19937 rng(42);
+    vector<int> tally(N, 0);
+    double likeSecs = timeIt([&]() {
+        for (int i = 0; i < N; ++i) {
+            size_t idx = (size_t)(rng() % N) * (rng() % N) / N;
+            big.likeComment(ids[idx]);
+            tally[idx]++;
+        }
+    });
+    vector<const Comment*> top;
+    double topSecs = timeIt([&]() { top = big.topComments(10); });
+
+    // What a sort-on-request listing would have to do instead
+    vector<pair<int, CommentId>> snapshot;
+    double sortSecs = timeIt([&]() {
+        snapshot.reserve(N);
+        for (int i = 0; i < N; ++i) snapshot.emplace_back(tally[i], ids[i]);
+        stable_sort(snapshot.begin(), snapshot.end(),
+                    [](const pair<int, CommentId>& a, const pair<int, CommentId>& b) { return a.first > b.first; });
+    });
+
+    Logger::log(Logger::PERF, "1000000 likes with incremental ranking: " + micros(likeSecs));
+    Logger::log(Logger::PERF, "Top 10 of 1000000 comments (maintained order): " + micros(topSecs));
+    Logger::log(Logger::PERF, "Top 10 of 1000000 comments (sort on request): " + micros(sortSecs));
+    Logger::log(Logger::PERF, string("Top comment likes ") +
+                (!top.empty() && top[0]->getLikes() == snapshot[0].first ? "match" : "DIFFER"));
+
+    CommentMemory mem = big.commentMemory();
+    auto mb = [](size_t bytes) { return to_string(bytes / (1024 * 1024)) + " MB"; };
+    Logger::log(Logger::PERF, "Comment memory for " + to_string(mem.live) + " comments: records " +
+                mb(mem.recordBytes) + ", text " + mb(mem.textBytes) + ", id index " +
+                mb(mem.indexBytes) + ", ranking " + mb(mem.rankingBytes) + ", threads " +
+                mb(mem.threadBytes) + ", total " + mb(mem.total()) + " (" +
+                to_string(mem.total() / max<size_t>(mem.live, 1)) + " bytes/comment)");
+}
+
+// Test 7: Comment storage, per-comment heap strings vs compact records + text arena
+static void benchCommentStorage() {
+    struct LegacyComment {
+        long long id;
+        string author;
+        string text;
+        int likes;
+        long long ts;
+    };
+    const int N = 200000, AUTHORS = 5000;
+    vector<string> authors, texts;  // Built up front so only storage is timed
+    authors.reserve(N);
+    texts.reserve(N);
+    for (int i = 0; i < N; ++i) {
+        authors.push_back("viewer_" + to_string(i % AUTHORS));
+        texts.push_back("Comment number " + to_string(i) + ", thanks for sharing this video!");
+    }
+    auto nowMs = []() {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    };
+
+    vector<LegacyComment> legacy;
+    double legacySecs = timeIt([&]() {
+        // Same id and timestamp work the old Comment constructor did
+        for (int i = 0; i < N; ++i) legacy.push_back({IdGen::next(IdKind::COMMENT), authors[i], texts[i], 0, nowMs()});
+    });
+    // Interned once per author, as User does, so the timed loop only stores
+    vector<uint32_t> handles;
+    for (int a = 0; a < AUTHORS; ++a) handles.push_back(AuthorPool::intern(authors[a]));
+    TextArena arena;
+    vector<Comment> packed;
+    long long start = nowMs();
+    double packedSecs = timeIt([&]() {
+        for (int i = 0; i < N; ++i) {
+            uint32_t offset = arena.append(texts[i]);
+            packed.emplace_back(handles[i % AUTHORS], offset, static_cast<uint32_t>(texts[i].size()),
+                                static_cast<uint32_t>((nowMs() - start) / 1000));
+        }
+    });
+
+    // libstdc++ keeps strings of up to 15 chars inline; longer ones own a heap block
+    size_t legacyBytes = legacy.capacity() * sizeof(LegacyComment);
+    for (const auto& c : legacy) {
+        if (c.author.capacity() > 15) legacyBytes += c.author.capacity() + 1;
+        if (c.text.capacity() > 15) legacyBytes += c.text.capacity() + 1;
+    }
+    size_t packedBytes = packed.capacity() * sizeof(Comment) + arena.bytesReserved();
+
+    Logger::log(Logger::PERF, "Comment storage, heap strings: " + to_string(legacyBytes / N) +
+                " bytes/comment, " + rate(N, legacySecs, "inserts"));
+    Logger::log(Logger::PERF, "Comment storage, compact records + arena: " + to_string(packedBytes / N) +
+                " bytes/comment, " + rate(N, packedSecs, "inserts"));
+}
+
+// Test 8: Paging a threaded video, top-level index and reply lists
+static void benchThreadedComments() {
+    QuietPerf quiet;
+    const int THREADS = 100000, REPLIES = 9;
+    Video forum(VideoId(1), "Busy thread", "bench", 60);
+    vector<CommentId> roots;
+    roots.reserve(THREADS);
+    for (int i = 0; i < THREADS; ++i) {
+        roots.push_back(CommentId(forum.addComment("op" + to_string(i % 100), "topic " + to_string(i)).id));
+    }
+    for (int r = 0; r < REPLIES; ++r) {
+        for (int i = 0; i < THREADS; ++i) forum.addReply("fan", roots[i], "reply " + to_string(r));
+    }
+
+    vector<const Comment*> page;
+    size_t seen = 0, replies = 0;
+    // Pages through the whole top level, one cursor at a time
+    double topSecs = timeIt([&]() {
+        long long cursor = 0;
+        do {
+            cursor = forum.commentsPage(cursor, Video::COMMENT_PAGE_SIZE, page).id;
+            seen += page.size();
+        } while (cursor > 0);
+    });
+    // Replies of the last thread, fetched through the ID index
+    double replySecs = timeIt([&]() {
+        long long cursor = 0;
+        do {
+            cursor = forum.repliesPage(roots.back(), cursor, Video::COMMENT_PAGE_SIZE, page).id;
+            replies += page.size();
+        } while (cursor > 0);
+    });
+
+    Logger::log(Logger::PERF, "All " + to_string(seen) + " top-level comments of " +
+                to_string(THREADS * (REPLIES + 1)) + " (paged): " + micros(topSecs));
+    Logger::log(Logger::PERF, "All " + to_string(replies) + " replies of the newest thread: " + micros(replySecs));
+}
+
+// Test 9: Concurrent likes, spread over many comments and piled onto one
+static void benchConcurrentLikes() {
+    QuietPerf quiet;
+    const int COMMENTS = 100000, LIKES = 4000000;
+    Video hot(VideoId(1), "Hot video", "bench", 60);
+    vector<CommentId> ids;
+    ids.reserve(COMMENTS);
+    for (int i = 0; i < COMMENTS; ++i) ids.push_back(CommentId(hot.addComment("fan", "comment").id));
+
+    auto run = [&](unsigned threads, bool viral) {
+        double secs = timeThreads(threads, [&](unsigned t) {
+            uint64_t x = t + 1;  // Cheap LCG so the generator doesn't dominate
+            for (int i = 0; i < LIKES / (int)threads; ++i) {
+                x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+                hot.likeCommentConcurrent(viral ? ids[0] : ids[(x >> 33) % COMMENTS]);
+            }
+        });
+        return rate((LIKES / threads) * threads, secs, "likes");
+    };
+
+    long long issued = 0;
+    for (unsigned threads : threadSteps(benchThreads())) {
+        string spread = run(threads, false);
+        string viral = run(threads, true);
+        issued += 2LL * (LIKES / threads) * threads;
+        Logger::log(Logger::PERF, "Concurrent likes, " + to_string(threads) + " threads: " +
+                    spread + " spread, " + viral + " on one comment");
+    }
+
+    size_t folded = 0;
+    double foldSecs = timeIt([&]() { folded = hot.foldLikes(); });
+    long long counted = 0;
+    vector<const Comment*> page;
+    long long cursor = 0;
+    do {
+        cursor = hot.commentsPage(cursor, 1000, page).id;
+        for (const Comment* c : page) counted += c->getLikes();
+    } while (cursor > 0);
+    Logger::log(Logger::PERF, "Folded " + to_string(folded) + " likes into the ranking: " + micros(foldSecs) +
+                " (" + (counted == issued ? "all counted" : "COUNT MISMATCH") + ")");
+}
+
+// Test 10: A burst of likes, one call per like vs one batch
+static void benchLikeBatch() {
+    QuietPerf quiet;
+    const int VIDEOS = 4, COMMENTS = 25000, LIKES = 1000000;
+    vector<unique_ptr<Video>> owned;
+    VideoTable byId;
+    vector<vector<CommentId>> ids(VIDEOS), twins(VIDEOS);
+    for (int v = 0; v < VIDEOS * 2; ++v) {
+        // Two identical sets: one for each path
+        owned.push_back(make_unique<Video>(VideoId(v + 1), "Burst " + to_string(v), "bench", 60));
+        byId.insert(owned.back().get());
+    }
+    for (int v = 0; v < VIDEOS; ++v) {
+        for (int i = 0; i < COMMENTS; ++i) {
+            ids[v].push_back(CommentId(owned[v]->addComment("fan", "comment").id));
+            twins[v].push_back(CommentId(owned[v + VIDEOS]->addComment("fan", "comment").id));
+        }
+    }
+
+    // Skewed towards early comments; the batch side gets the same
+    // likes aimed at the twin comments
+    mt19937 rng(7);
+    vector<LikeEvent> single, batch;
+    single.reserve(LIKES);
+    batch.reserve(LIKES);
+    for (int i = 0; i < LIKES; ++i) {
+        int v = rng() % VIDEOS;
+        size_t idx = (size_t)(rng() % COMMENTS) * (rng() % COMMENTS) / COMMENTS;
+        single.push_back({owned[v]->getId(), ids[v][idx], 1});
+        batch.push_back({owned[v + VIDEOS]->getId(), twins[v][idx], 1});
+    }
+
+    User fan("benchfan");
+    double singleSecs = timeIt([&]() {
+        for (const LikeEvent& e : single) {
+            Video* v = byId.find(e.videoId);
+            if (v) fan.likeComment(v, e.commentId);
+        }
+    });
+    size_t applied = 0;
+    double batchSecs = timeIt([&]() { applied = applyLikeBatch(batch, byId); });
+
+    bool same = applied == (size_t)LIKES;
+    for (int v = 0; v < VIDEOS && same; ++v) {
+        auto a = owned[v]->topComments(10), b = owned[v + VIDEOS]->topComments(10);
+        for (size_t i = 0; i < a.size() && same; ++i) same = a[i]->getLikes() == b[i]->getLikes();
+    }
+    Logger::log(Logger::PERF, "1000000 likes, one call each: " + rate(LIKES, singleSecs, "likes"));
+    Logger::log(Logger::PERF, "1000000 likes, one batch: " + rate(LIKES, batchSecs, "likes") +
+                (same ? " (rankings match)" : " (RANKINGS DIFFER)"));
+}
+
+// Test 11: Plays of one video from N threads, shared atomic vs striped counter
+static void benchStripedViews() {
+    const long long PLAYS = 8000000;
+    for (unsigned threads : threadSteps(benchThreads())) {
+        long long each = PLAYS / threads;
+        atomic<long long> shared{0};
+        Video viral(VideoId(1), "Viral", "bench", 60);
+        double plainSecs = timeThreads(threads, [&](unsigned) {
+            for (long long i = 0; i < each; ++i) shared.fetch_add(1, memory_order_relaxed);
+        });
+        double stripedSecs = timeThreads(threads, [&](unsigned) {
+            for (long long i = 0; i < each; ++i) viral.recordView();
+        });
+        bool exact = viral.getViews() == each * threads;
+        Logger::log(Logger::PERF, "Views from " + to_string(threads) + " threads: shared atomic " +
+                    rate(each * threads, plainSecs, "plays") + ", striped " +
+                    rate(each * threads, stripedSecs, "plays") + (exact ? "" : " (COUNT MISMATCH)"));
+    }
+}
+
+// Test 12: 1M open playback sessions with churn, slab vs hash map of sessions
+static void benchSessions() {
+    QuietPerf quiet;
+    const int SESSIONS = 1000000;
+    Video clip(VideoId(1), "Clip", "bench", 600);
+
+    SessionPool slab;
+    vector<SessionId> ids;
+    ids.reserve(SESSIONS);
+    double slabSecs = timeIt([&]() {
+        for (int i = 0; i < SESSIONS; ++i) ids.push_back(SessionId(slab.start("viewer", &clip).id));
+        // Half the viewers leave and as many new ones arrive
+        for (int i = 0; i < SESSIONS; i += 2) {
+            slab.end(ids[i]);
+            ids[i] = SessionId(slab.start("viewer", &clip).id);
+        }
+        for (SessionId id : ids) slab.end(id);
+    });
+
+    unordered_map<SessionId, PlaybackSession> byId;
+    auto open = [&]() {
+        SessionId id = IdGen::next<SessionId>();
+        byId[id] = {id, &clip, AuthorPool::intern("viewer"), 0, PlaybackState::PLAYING, 0};
+        return id;
+    };
+    double mapSecs = timeIt([&]() {
+        for (int i = 0; i < SESSIONS; ++i) ids[i] = open();
+        for (int i = 0; i < SESSIONS; i += 2) {
+            byId.erase(ids[i]);
+            ids[i] = open();
+        }
+        for (SessionId id : ids) byId.erase(id);
+    });
+
+    // 1.5M starts and as many ends
+    Logger::log(Logger::PERF, "Session start/end, slab: " + nanosEach(slabSecs, 3 * SESSIONS) + " per op, " +
+                to_string(slab.capacity()) + " slots for 1000000 peak, " +
+                to_string(slab.activeSessions()) + " left open");
+    Logger::log(Logger::PERF, "Session start/end, hash map: " + nanosEach(mapSecs, 3 * SESSIONS) + " per op");
+}
+
+// Test 13: Unique viewers, HyperLogLog sketch vs exact set of usernames
+static void benchUniqueViewers() {
+    auto pct = [](long long est, size_t exact) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.2f%%", 100.0 * fabs((double)est - (double)exact) / (double)exact);
+        return string(buf);
+    };
+    for (size_t viewers : {1000, 100000, 1000000}) {
+        HyperLogLog sketch;
+        unordered_set<string> exact;
+        // Every viewer comes back a few times; only the first watch is new
+        for (int round = 0; round < 3; ++round) {
+            for (size_t i = 0; i < viewers; ++i) {
+                string name = "viewer" + to_string(i);
+                sketch.add(name);
+                exact.insert(name);
+            }
+        }
+        // Bucket array plus one node (next pointer, string, cached hash) per name
+        size_t setBytes = exact.bucket_count() * sizeof(void*) +
+                          exact.size() * (2 * sizeof(void*) + sizeof(string));
+        Logger::log(Logger::PERF, "Unique viewers " + to_string(viewers) + ": sketch ~" +
+                    to_string(sketch.estimate()) + " (" + pct(sketch.estimate(), exact.size()) +
+                    " off) in " + to_string(sketch.bytes() / 1024) + " KB, exact set " +
+                    to_string(setBytes / 1024) + " KB");
+    }
+
+    // A channel's audience: ten videos with overlapping viewers
+    HyperLogLog channel;
+    unordered_set<string> everyone;
+    for (int v = 0; v < 10; ++v) {
+        HyperLogLog video;
+        for (int i = v * 20000; i < v * 20000 + 50000; ++i) {
+            string name = "viewer" + to_string(i);
+            video.add(name);
+            everyone.insert(name);
+        }
+        channel.merge(video);
+    }
+    Logger::log(Logger::PERF, "Channel audience from 10 merged sketches: ~" + to_string(channel.estimate()) +
+                " vs " + to_string(everyone.size()) + " exact (" +
+                pct(channel.estimate(), everyone.size()) + " off)");
+}
+
+// Test 14: Views recorded into minute/hour/day rings over two simulated days
+static void benchTimeline() {
+    const long long VIEWS = 10000000;
+    const long long start = ViewTimeline::nowSeconds();
+    const long long span = 2 * 86400;  // Views spread evenly over the span
+    ViewTimeline timeline;
+    double recordSecs = timeIt([&]() {
+        for (long long i = 0; i < VIEWS; ++i) timeline.record(start + i * span / VIEWS);
+    });
+    long long end = start + span - 1;
+    long long hour = 0, day = 0;
+    double querySecs = timeIt([&]() {
+        for (int q = 0; q < 1000; ++q) {
+            hour = timeline.count(ViewTimeline::MINUTE, 60, end);
+            day = timeline.count(ViewTimeline::HOUR, 24, end);
+        }
+    });
+
+    // Same views from several threads, all hitting the same buckets
+    ViewTimeline shared;
+    unsigned threads = benchThreads();
+    double sharedSecs = timeThreads(threads, [&](unsigned) {
+        for (long long i = 0; i < VIEWS / threads; ++i) shared.record(start);
+    });
+    bool exact = shared.count(ViewTimeline::MINUTE, 1, start) == VIEWS / threads * threads;
+
+    // Each hour of the span got VIEWS / 48 views
+    Logger::log(Logger::PERF, "Timeline record: " + rate(VIEWS, recordSecs, "views") + " (1 thread), " +
+                rate(VIEWS, sharedSecs, "views") + " (" + to_string(threads) + " threads" +
+                (exact ? ")" : ", COUNT MISMATCH)"));
+    Logger::log(Logger::PERF, "Timeline last hour " + to_string(hour) + ", last day " + to_string(day) +
+                " (expected ~" + to_string(VIEWS / 48) + ", ~" + to_string(VIEWS / 2) + "), " +
+                nanosEach(querySecs, 2000) + " per query, " + to_string(timeline.bytes()) + " bytes per video");
+}
+
+// Test 15: Trending over 100k videos, maintained top list vs decaying and sorting everything
+static void benchTrending() {
+    const int VIDEOS = 100000, PLAYS = 5000000;
+    vector<unique_ptr<Video>> catalog;
+    TrendingIndex trend(3600);
+    for (int i = 0; i < VIDEOS; ++i) {
+        catalog.push_back(make_unique<Video>(VideoId(i + 1), "Trend " + to_string(i), "bench", 60));
+        trend.add(catalog.back().get());
+    }
+
+    // Two simulated days; which videos are popular drifts over time
+    mt19937 rng(11);
+    const double start = TrendingIndex::nowSeconds(), span = 2 * 86400;
+    vector<int> picks(PLAYS);
+    for (int i = 0; i < PLAYS; ++i) {
+        int hot = (int)((long long)i * VIDEOS / PLAYS);
+        picks[i] = (hot + (int)((size_t)(rng() % VIDEOS) * (rng() % VIDEOS) / VIDEOS)) % VIDEOS;
+    }
+    double playSecs = timeIt([&]() {
+        for (int i = 0; i < PLAYS; ++i) trend.recordPlay(catalog[picks[i]].get(), start + span * i / PLAYS);
+    });
+    const double now = start + span;
+    vector<TrendingEntry> top;
+    double topSecs = timeIt([&]() { top = trend.trending(10, now); });
+
+    // The scan a trending page would need without the index
+    vector<pair<double, Video*>> all;
+    double scanSecs = timeIt([&]() {
+        all.reserve(VIDEOS);
+        for (auto& v : catalog) all.emplace_back(trend.score(v.get(), now), v.get());
+        partial_sort(all.begin(), all.begin() + 10, all.end(),
+                     [](const pair<double, Video*>& a, const pair<double, Video*>& b) { return a.first > b.first; });
+    });
+
+    bool same = top.size() == 10;
+    for (size_t i = 0; i < top.size() && same; ++i) same = top[i].video == all[i].second;
+    Logger::log(Logger::PERF, "Trending updates: " + rate(PLAYS, playSecs, "plays") + " over " +
+                to_string(VIDEOS) + " videos");
+    Logger::log(Logger::PERF, "Trending top 10 (maintained): " + micros(topSecs) + ", (scan + sort): " +
+                micros(scanSecs) + (same ? " (same videos)" : " (DIFFERENT VIDEOS)"));
+}
+
+// Test 16: IDs from 1 to 64 threads, one shared counter vs per-thread blocks
+static void benchIdBlocks() {
+    const long long IDS = 2000000;
+    // Every ID is kept so duplicates can be looked for afterwards
+    auto drive = [&](unsigned threads, const function<long long()>& gen, bool& unique) {
+        vector<vector<long long>> out(threads);
+        for (auto& o : out) o.reserve(IDS / threads);
+        double secs = timeThreads(threads, [&](unsigned t) {
+            for (long long i = 0; i < IDS / threads; ++i) out[t].push_back(gen());
+        });
+        unique = allDistinct(out);
+        return rate(IDS / threads * threads, secs, "IDs");
+    };
+
+    for (unsigned threads : threadSteps(64)) {
+        atomic<long long> shared{0};
+        bool sharedUnique = false, blocksUnique = false;
+        string plain = drive(threads, [&]() { return shared.fetch_add(1, memory_order_relaxed) + 1; }, sharedUnique);
+        string blocks = drive(threads, []() { return IdGen::next(IdKind::COMMENT); }, blocksUnique);
+        Logger::log(Logger::PERF, "IDs from " + to_string(threads) + " threads: shared counter " + plain +
+                    ", per-thread blocks " + blocks + (sharedUnique && blocksUnique ? "" : " (DUPLICATE IDS)"));
+    }
+}
+
+// Test 17: Snowflake IDs from 1 to 64 threads split over two simulated
+// nodes, checked for duplicates, per-thread order and what they encode
+static void benchSnowflake() {
+    const long long IDS = 1000000;
+    for (unsigned threads : threadSteps(64)) {
+        SnowflakeGen nodeA(1), nodeB(2);
+        SnowflakeGen* nodes[2] = {&nodeA, &nodeB};
+        vector<vector<long long>> out(threads);
+        for (auto& o : out) o.reserve(IDS / threads);
+        long long startMs = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+
+        double secs = timeThreads(threads, [&](unsigned t) {
+            SnowflakeGen& gen = *nodes[t % 2];
+            for (long long i = 0; i < IDS / threads; ++i) out[t].push_back(gen.next());
+        });
+
+        bool ok = allDistinct(out);
+        long long newest[2] = {0, 0};
+        for (unsigned t = 0; t < threads; ++t) {
+            const vector<long long>& ids = out[t];
+            // Every thread sees its own IDs strictly increase
+            ok = ok && adjacent_find(ids.begin(), ids.end(), greater_equal<long long>()) == ids.end();
+            for (long long id : ids) {
+                ok = ok && SnowflakeGen::nodeOf(id) == t % 2 + 1 && SnowflakeGen::timestampOf(id) >= startMs;
+            }
+            if (!ids.empty()) newest[t % 2] = max(newest[t % 2], ids.back());
+        }
+        // Whatever a node hands out next sorts after everything it handed out so far
+        ok = ok && nodeA.next() > newest[0] && nodeB.next() > newest[1];
+
+        Logger::log(Logger::PERF, "Snowflake IDs from " + to_string(threads) + " threads on 2 nodes: " +
+                    rate(IDS / threads * threads, secs, "IDs") + ", " +
+                    (ok ? "unique and ordered" : "DUPLICATE OR OUT-OF-ORDER IDS"));
+    }
+}
+
+void runBenchmarks(const VideoTable& videos) {
+    cout << "\n=== PERFORMANCE BENCHMARK ===\n";
+    PERF_LOGGING = true;
+
+    benchLookup(videos);
+    benchLookupTable();
+    benchAddComments(videos);
+    benchCatalogScan(videos);
+    benchTitleScan();
+    benchShardedScan();
+    benchTopComments();
+    benchCommentStorage();
+    benchThreadedComments();
+    benchConcurrentLikes();
+    benchLikeBatch();
+    benchStripedViews();
+    benchSessions();
+    benchUniqueViewers();
+    benchTimeline();
+    benchTrending();
+    benchIdBlocks();
+    benchSnowflake();
+
+    PERF_LOGGING = false;
+    cout << "=== BENCHMARK COMPLETE ===\n\n";
+}
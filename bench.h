@@ -0,0 +1,9 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "video.h"
+
+// Runs every benchmark of menu option 18; the first tests time the real catalog
+void runBenchmarks(const VideoTable& videos);
+
+#endif
@@ -1,4 +1,8 @@
 #include "user.h"
+#include "search.h"
+#include "trending.h"
+#include "bench.h"
+#include <cstdio>
 
 // Helper to read a line of input with a prompt
 static string readLine(const string& prompt) {
@@ -34,15 +38,35 @@ static long long readLongLong(const string& prompt) {
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     // Speed up I/O operations
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
+    // "--node N" runs this process as simulation node N with snowflake IDs, so
+    // its videos and comments can be merged with other nodes'. Has to happen
+    // before anything below takes an ID.
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--node" && i + 1 < argc) {
+            long long node = -1;
+            try { node = stoll(argv[++i]); } catch (...) {}
+            OpResult result = IdGen::useSnowflake(node);
+            if (!result.isSuccess()) {
+                Logger::error(result.message);
+                return 1;
+            }
+            Logger::info(result.message);
+        } else {
+            Logger::error("Usage: " + string(argv[0]) + " [--node N]");
+            return 1;
+        }
+    }
+
     // Main data structures
     unordered_map<string, User> users;
     unordered_map<string, Channel> channels;
-    unordered_map<long long, Video*> videos;  // Videos are owned by channels
+    VideoTable videos;  // Videos are owned by channels
 
     // Create some default channels
     channels.emplace("KavyaTech", Channel("KavyaTech", "system", "C++ tutorials"));
@@ -51,13 +75,16 @@ int main() {
     // Add some initial videos
     {
         Video* v = channels["KavyaTech"].upload("C++ OOP Deep Dive", 900);
-        videos[v->getId()] = v;
+        videos.insert(v);
         v = channels["KavyaTech"].upload("Data Structures Overview", 720);
-        videos[v->getId()] = v;
+        videos.insert(v);
         v = channels["IndieMusic"].upload("Chill Loops", 300);
-        videos[v->getId()] = v;
+        videos.insert(v);
     }
 
+    // Scans the trigram index can't serve get split across cores
+    SEARCH_INDEX.setScanThreads(thread::hardware_concurrency());
+
     User* current = nullptr;  // Currently logged in user
 
     // Display the menu
@@ -74,7 +101,7 @@ int main() {
         cout << "8  Add comment to video (logged in)\n";
         cout << "9  Like comment on video (logged in)\n";
         cout << "10 List comments on video\n";
-        cout << "11 Search videos by title\n";
+        cout << "11 Search videos by title (end with ~0 for whole words, ~1 or ~2 to allow typos)\n";
         cout << "12 Create playlist (logged in)\n";
         cout << "13 Add video to playlist (logged in)\n";
         cout << "14 Play playlist (logged in)\n";
@@ -82,6 +109,14 @@ int main() {
         cout << "16 List channel uploads\n";
         cout << "17 Toggle performance logging\n";
         cout << "18 Run performance benchmark\n";
+        cout << "19 Autocomplete video titles\n";
+        cout << "20 Top comments on video\n";
+        cout << "21 Reply to comment (logged in)\n";
+        cout << "22 List replies to comment\n";
+        cout << "23 Pause or resume what you're watching (logged in)\n";
+        cout << "24 Recent views of channel uploads\n";
+        cout << "25 Trending videos\n";
+        cout << "26 Seek in what you're watching (logged in)\n";
         cout << "99 Exit\n";
     };
 
@@ -116,7 +151,11 @@ int main() {
         else if (cmd == 3) {
             // Logout
             if (!current) cout << "Not logged in\n";
-            else { cout << "Logged out " << current->getUsername() << "\n"; current = nullptr; }
+            else {
+                current->stopWatching();
+                cout << "Logged out " << current->getUsername() << "\n";
+                current = nullptr;
+            }
         } 
         else if (cmd == 4) {
             // Create a channel
@@ -140,7 +179,7 @@ int main() {
             string title = readLine("Video title: ");
             int dur = readInt("Duration seconds: ");
             Video* v = cit->second.upload(title, dur);
-            videos[v->getId()] = v;
+            videos.insert(v);
         } 
         else if (cmd == 6) {
             // Subscribe to a channel
@@ -153,39 +192,48 @@ int main() {
         } 
         else if (cmd == 7) {
             // Watch a video
-            long long vid = readLongLong("Video id to watch: ");
-            auto vit = videos.find(vid);
-            if (vit == videos.end()) { cout << "Video not found\n"; continue; }
+            VideoId vid(readLongLong("Video id to watch: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
             
-            OpResult result = current ? current->watch(vit->second) : vit->second->play();
+            OpResult result = current ? current->watch(video) : video->play();
             cout << result.message << "\n";
         } 
         else if (cmd == 8) {
             // Add a comment
             if (!current) { cout << "Login required\n"; continue; }
-            long long vid = readLongLong("Video id to comment on: ");
-            auto vit = videos.find(vid);
-            if (vit == videos.end()) { cout << "Video not found\n"; continue; }
+            VideoId vid(readLongLong("Video id to comment on: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
             string text = readLine("Comment text: ");
-            auto result = current->addComment(vit->second, text);
+            auto result = current->addComment(video, text);
             cout << result.message << "\n";
         } 
         else if (cmd == 9) {
             // Like a comment
             if (!current) { cout << "Login required\n"; continue; }
-            long long vid = readLongLong("Video id: ");
-            auto vit = videos.find(vid);
-            if (vit == videos.end()) { cout << "Video not found\n"; continue; }
-            long long cid = readLongLong("Comment id to like: ");
-            auto result = current->likeComment(vit->second, cid);
+            VideoId vid(readLongLong("Video id: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
+            CommentId cid(readLongLong("Comment id to like: "));
+            auto result = current->likeComment(video, cid);
             cout << result.message << "\n";
         } 
         else if (cmd == 10) {
             // List comments on a video
-            long long vid = readLongLong("Video id to list comments: ");
-            auto vit = videos.find(vid);
-            if (vit == videos.end()) { cout << "Video not found\n"; continue; }
-            vit->second->listComments();
+            VideoId vid(readLongLong("Video id to list comments: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
+            // One page at a time so long threads don't block the command loop
+            long long cursor = 0;
+            while (true) {
+                OpResult page = video->listComments(cursor);
+                if (!page.isSuccess()) { cout << page.message << "\n"; break; }
+                if (page.id < 0) break;
+                string more = readLine("More comments? (y/n): ");
+                if (more != "y" && more != "Y") break;
+                cursor = page.id;
+            }
         } 
         else if (cmd == 11) {
             // Search videos by title
@@ -193,17 +241,16 @@ int main() {
             
             string q = readLine("Search keyword: ");
             cout << "Results:\n";
-            string low = q;
-            transform(low.begin(), low.end(), low.begin(), ::tolower);
-            
-            for (auto &p : videos) {
-                string t = p.second->getTitle();
-                string tl = t;
-                transform(tl.begin(), tl.end(), tl.begin(), ::tolower);
-                if (tl.find(low) != string::npos) {
-                    cout << "  [" << p.first << "] " << t 
-                         << " (channel: " << p.second->getUploader() << ")\n";
-                }
+
+            // Best matches first; only the top results are kept and printed
+            for (const SearchHit& h : SEARCH_INDEX.search(q)) {
+                cout << "  [" << h.video->getId() << "] " << h.video->getTitle()
+                     << " (channel: " << h.video->getUploader() << ")\n";
+            }
+            if (PERF_LOGGING) {
+                const QueryCache& qc = SEARCH_INDEX.queryCache();
+                Logger::log(Logger::PERF, "Search cache: " + to_string(qc.getHits()) + " hits, " +
+                            to_string(qc.getMisses()) + " misses");
             }
         } 
         else if (cmd == 12) {
@@ -219,10 +266,10 @@ int main() {
             string pname = readLine("Playlist name: ");
             Playlist* p = current->getPlaylist(pname);
             if (!p) { cout << "Playlist not found\n"; continue; }
-            long long vid = readLongLong("Video id to add: ");
-            auto vit = videos.find(vid);
-            if (vit == videos.end()) { cout << "Video not found\n"; continue; }
-            p->add(vid, vit->second->getTitle());
+            VideoId vid(readLongLong("Video id to add: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
+            p->add(vid, video->getTitle());
         } 
         else if (cmd == 14) {
             // Play a playlist
@@ -235,24 +282,23 @@ int main() {
             p->show(videos);
             
             cout << "Playing playlist \"" << pname << "\"\n";
-            for (long long vid : p->getVideoIds()) {
-                auto it = videos.find(vid);
-                if (it != videos.end()) {
-                    it->second->play();
-                    it->second->pause();
-                }
+            // Each video gets its own session, closed as the next one starts
+            for (VideoId vid : p->getVideoIds()) {
+                Video* video = videos.find(vid);
+                if (video) current->watch(video);
             }
+            current->stopWatching();
         } 
         else if (cmd == 15) {
             // List all videos
             PerfTimer timer("List all videos", PERF_LOGGING);
             
             cout << "All videos:\n";
-            for (auto &p : videos) {
-                cout << "  [" << p.first << "] " << p.second->getTitle() 
-                     << " (channel: " << p.second->getUploader() 
-                     << ", views: " << p.second->getViews() << ")\n";
-            }
+            videos.forEach([](Video* v) {
+                cout << "  [" << v->getId() << "] " << v->getTitle() 
+                     << " (channel: " << v->getUploader() 
+                     << ", views: " << v->getViews() << ")\n";
+            });
         } 
         else if (cmd == 16) {
             // List channel uploads
@@ -268,42 +314,84 @@ int main() {
         } 
         else if (cmd == 18) {
             // Run performance benchmark
-            cout << "\n=== PERFORMANCE BENCHMARK ===\n";
-            PERF_LOGGING = true;
-            
-            // Test 1: Video lookup speed
-            {
-                PerfTimer t("1000 video lookups");
-                for (int i = 0; i < 1000; ++i) {
-                    volatile auto it = videos.find(1);
-                    (void)it;  // Prevent compiler optimization
-                }
+            runBenchmarks(videos);
+        } 
+        else if (cmd == 19) {
+            // Suggest titles for a partially typed word, most viewed first
+            string prefix = readLine("Prefix: ");
+            PerfTimer timer("Autocomplete", PERF_LOGGING);
+
+            auto hits = SEARCH_INDEX.suggest(prefix, 5);
+            if (hits.empty()) { cout << "No suggestions\n"; continue; }
+            cout << "Suggestions:\n";
+            for (Video* v : hits) {
+                cout << "  [" << v->getId() << "] " << v->getTitle()
+                     << " (views: " << v->getViews() << ")\n";
             }
-            
-            // Test 2: Comment addition speed
-            if (!videos.empty()) {
-                Video* testVid = videos.begin()->second;
-                PerfTimer t("100 comment additions");
-                for (int i = 0; i < 100; ++i) {
-                    testVid->addComment("benchuser", "test comment");
-                }
+        } 
+        else if (cmd == 20) {
+            // Most liked comments, read straight off the maintained ranking
+            VideoId vid(readLongLong("Video id: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
+            PerfTimer timer("Top comments", PERF_LOGGING);
+            video->listTopComments(5);
+        } 
+        else if (cmd == 21) {
+            // Reply to a comment or to another reply
+            if (!current) { cout << "Login required\n"; continue; }
+            VideoId vid(readLongLong("Video id: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
+            CommentId cid(readLongLong("Comment id to reply to: "));
+            string text = readLine("Reply text: ");
+            auto result = current->addReply(video, cid, text);
+            cout << result.message << "\n";
+        } 
+        else if (cmd == 22) {
+            // Replies are loaded one page at a time, only when asked for
+            VideoId vid(readLongLong("Video id: "));
+            Video* video = videos.find(vid);
+            if (!video) { cout << "Video not found\n"; continue; }
+            CommentId cid(readLongLong("Comment id: "));
+            long long cursor = 0;
+            while (true) {
+                OpResult page = video->listReplies(cid, cursor);
+                if (!page.isSuccess()) { cout << page.message << "\n"; break; }
+                if (page.id < 0) break;
+                string more = readLine("More replies? (y/n): ");
+                if (more != "y" && more != "Y") break;
+                cursor = page.id;
             }
-            
-            // Test 3: Search performance
-            {
-                PerfTimer t("Video search");
-                string query = "c++";
-                transform(query.begin(), query.end(), query.begin(), ::tolower);
-                int count = 0;
-                for (auto &p : videos) {
-                    string title = p.second->getTitle();
-                    transform(title.begin(), title.end(), title.begin(), ::tolower);
-                    if (title.find(query) != string::npos) count++;
-                }
+        } 
+        else if (cmd == 23) {
+            if (!current) { cout << "Login required\n"; continue; }
+            cout << current->togglePause().message << "\n";
+        } 
+        else if (cmd == 24) {
+            string cname = readLine("Channel name: ");
+            auto cit = channels.find(cname);
+            if (cit == channels.end()) { cout << "Channel not found\n"; continue; }
+            cit->second.listRecentViews();
+        } 
+        else if (cmd == 25) {
+            // Read straight off the maintained top list, no scan of the catalog
+            PerfTimer timer("Trending", PERF_LOGGING);
+            auto hot = TRENDING.trending(5, TrendingIndex::nowSeconds());
+            if (hot.empty()) { cout << "Nothing trending yet\n"; continue; }
+            cout << "Trending now:\n";
+            for (const TrendingEntry& e : hot) {
+                char score[32];
+                snprintf(score, sizeof(score), "%.2f", e.score);
+                cout << "  [" << e.video->getId() << "] " << e.video->getTitle()
+                     << " (score " << score << ", views: " << e.video->getViews() << ")\n";
             }
-            
-            PERF_LOGGING = false;
-            cout << "=== BENCHMARK COMPLETE ===\n\n";
+        } 
+        else if (cmd == 26) {
+            if (!current) { cout << "Login required\n"; continue; }
+            int pos = readInt("Position in seconds: ");
+            if (pos < 0) { cout << "Invalid position\n"; continue; }
+            cout << current->seek(static_cast<uint32_t>(pos)).message << "\n";
         } 
         else if (cmd == 99) {
             cout << "Goodbye\n";
@@ -0,0 +1,528 @@
+#include "search.h"
+#include "textmatch.h"
+#include <cmath>
+
+SearchIndex SEARCH_INDEX;
+
+// TopHits implementation
+TopHits::TopHits(size_t k) : k(k) { heap.reserve(k); }
+
+bool TopHits::better(const SearchHit& a, const SearchHit& b) {
+    if (a.score != b.score) return a.score > b.score;
+    return a.video->getId() < b.video->getId();
+}
+
+void TopHits::offer(const SearchHit& h) {
+    if (k == 0) return;
+    if (heap.size() < k) {
+        heap.push_back(h);
+        push_heap(heap.begin(), heap.end(), better);
+    } else if (better(h, heap.front())) {
+        pop_heap(heap.begin(), heap.end(), better);
+        heap.back() = h;
+        push_heap(heap.begin(), heap.end(), better);
+    }
+}
+
+vector<SearchHit> TopHits::take() {
+    sort_heap(heap.begin(), heap.end(), better);
+    vector<SearchHit> out;
+    out.swap(heap);
+    return out;
+}
+
+// FuzzyIndex implementation
+void FuzzyIndex::variants(const string& word, int budget, unordered_set<string>& out) {
+    if (!out.insert(word).second || budget == 0) return;
+    for (size_t i = 0; i < word.size(); ++i) {
+        variants(word.substr(0, i) + word.substr(i + 1), budget - 1, out);
+    }
+}
+
+void FuzzyIndex::addWord(const string& word) {
+    uint32_t id = static_cast<uint32_t>(words.size());
+    words.push_back(word);
+    unordered_set<string> vars;
+    variants(word.substr(0, PREFIX_LENGTH), MAX_DISTANCE, vars);
+    for (const string& v : vars) deletes[v].push_back(id);
+}
+
+vector<pair<const string*, int>> FuzzyIndex::lookup(const string& word, int maxDist) const {
+    vector<pair<const string*, int>> out;
+    maxDist = max(0, min(maxDist, MAX_DISTANCE));
+
+    // Two words within d edits always share a variant with at most d deletions
+    // each, and so do their prefixes: an edit that shifts a character past the
+    // prefix end costs one deletion on each side, like any other edit
+    unordered_set<string> vars;
+    variants(word.substr(0, PREFIX_LENGTH), maxDist, vars);
+    unordered_set<uint32_t> checked;
+    for (const string& v : vars) {
+        auto it = deletes.find(v);
+        if (it == deletes.end()) continue;
+        for (uint32_t id : it->second) {
+            if (!checked.insert(id).second) continue;
+            int d = editDistance(word, words[id], maxDist);
+            if (d <= maxDist) out.emplace_back(&words[id], d);
+        }
+    }
+    return out;
+}
+
+int FuzzyIndex::editDistance(const string& a, const string& b, int maxDist) {
+    int n = static_cast<int>(a.size()), m = static_cast<int>(b.size());
+    if (abs(n - m) > maxDist) return maxDist + 1;
+
+    vector<int> prev(m + 1), cur(m + 1);
+    for (int j = 0; j <= m; ++j) prev[j] = j;
+    for (int i = 1; i <= n; ++i) {
+        cur[0] = i;
+        int rowMin = cur[0];
+        for (int j = 1; j <= m; ++j) {
+            int subst = prev[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            cur[j] = min(subst, min(prev[j], cur[j - 1]) + 1);
+            rowMin = min(rowMin, cur[j]);
+        }
+        if (rowMin > maxDist) return maxDist + 1;
+        prev.swap(cur);
+    }
+    return min(prev[m], maxDist + 1);
+}
+
+// QueryCache implementation
+QueryCache::QueryCache(size_t capacity) : capacity(capacity) {}
+
+QueryCache::Entry* QueryCache::find(const string& key) {
+    auto it = byKey.find(key);
+    if (it == byKey.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    entries.splice(entries.begin(), entries, it->second);
+    return &entries.front();
+}
+
+QueryCache::Entry& QueryCache::insert(Entry e) {
+    auto it = byKey.find(e.key);
+    if (it != byKey.end()) {
+        entries.erase(it->second);
+        byKey.erase(it);
+    }
+    if (capacity > 0 && entries.size() >= capacity) {
+        byKey.erase(entries.back().key);
+        entries.pop_back();
+    }
+    entries.push_front(move(e));
+    byKey[entries.front().key] = entries.begin();
+    return entries.front();
+}
+
+list<QueryCache::Entry>& QueryCache::all() { return entries; }
+
+void QueryCache::markBroad() {
+    for (Entry& e : entries) {
+        if (e.matches.size() > MAX_MATCHES) {
+            e.broad = true;
+            vector<TitleMatch>().swap(e.matches);
+        }
+    }
+}
+
+long long QueryCache::getHits() const { return hits; }
+long long QueryCache::getMisses() const { return misses; }
+size_t QueryCache::size() const { return entries.size(); }
+
+// PrefixIndex implementation
+PrefixIndex::PrefixIndex() : nodes(1) {}
+
+uint32_t PrefixIndex::child(uint32_t node, char ch, bool create) {
+    auto& kids = nodes[node].children;
+    auto it = lower_bound(kids.begin(), kids.end(), make_pair(ch, 0u));
+    if (it != kids.end() && it->first == ch) return it->second;
+    if (!create) return 0;
+
+    uint32_t idx = static_cast<uint32_t>(nodes.size());
+    kids.insert(it, make_pair(ch, idx));  // Insert before growing nodes, which moves kids
+    nodes.emplace_back();
+    return idx;
+}
+
+void PrefixIndex::offer(uint32_t node, Video* v) {
+    offerMonotone(nodes[node].top, LIMIT, v,
+                  [](const Video* a, const Video* b) { return a == b; },
+                  [](const Video* x) { return x->getViews(); });
+}
+
+void PrefixIndex::walk(Video* v, bool create) {
+    uint32_t node = 0;
+    for (char ch : v->getTitle()) {
+        if (isspace(static_cast<unsigned char>(ch))) {
+            node = 0;  // Next word starts again from the root
+            continue;
+        }
+        node = child(node, static_cast<char>(tolower(static_cast<unsigned char>(ch))), create);
+        if (node == 0) return;  // Not indexed yet, nothing to rerank
+        offer(node, v);
+    }
+}
+
+void PrefixIndex::add(Video* v) { walk(v, true); }
+
+void PrefixIndex::viewsChanged(Video* v) { walk(v, false); }
+
+vector<Video*> PrefixIndex::complete(const string& prefix, size_t n) const {
+    uint32_t node = 0;
+    for (char ch : prefix) {
+        char low = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        const auto& kids = nodes[node].children;
+        auto it = lower_bound(kids.begin(), kids.end(), make_pair(low, 0u));
+        if (it == kids.end() || it->first != low) return {};
+        node = it->second;
+    }
+    if (node == 0) return {};
+
+    const auto& top = nodes[node].top;
+    return vector<Video*>(top.begin(), top.begin() + min(n, top.size()));
+}
+
+// SearchIndex implementation
+string SearchIndex::toLower(const string& s) {
+    string out = s;
+    transform(out.begin(), out.end(), out.begin(), ::tolower);
+    return out;
+}
+
+vector<string> SearchIndex::tokenize(const string& text) {
+    vector<string> tokens;
+    string cur;
+    for (char ch : text) {
+        if (isspace(static_cast<unsigned char>(ch))) {
+            if (!cur.empty()) tokens.push_back(move(cur));
+            cur.clear();
+        } else {
+            cur += static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        }
+    }
+    if (!cur.empty()) tokens.push_back(move(cur));
+    return tokens;
+}
+
+void SearchIndex::appendId(vector<long long>& list, long long id) {
+    // IDs from one thread only grow, so this is nearly always an append. A video
+    // whose ID came from another thread's block can still arrive late.
+    if (list.empty() || list.back() < id) {
+        list.push_back(id);
+        return;
+    }
+    auto pos = lower_bound(list.begin(), list.end(), id);
+    if (*pos != id) list.insert(pos, id);  // Skip repeats within a title
+}
+
+uint32_t SearchIndex::trigramKey(const string& s, size_t pos) {
+    return (static_cast<uint32_t>(static_cast<unsigned char>(s[pos])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(s[pos + 1])) << 8) |
+            static_cast<uint32_t>(static_cast<unsigned char>(s[pos + 2]));
+}
+
+vector<long long> SearchIndex::intersect(vector<const vector<long long>*>& lists) {
+    // Start from the shortest list so the working set only shrinks
+    sort(lists.begin(), lists.end(),
+         [](const vector<long long>* a, const vector<long long>* b) { return a->size() < b->size(); });
+
+    vector<long long> result = *lists[0];
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        const vector<long long>& other = *lists[i];
+        auto pos = other.begin();
+        size_t kept = 0;
+        for (long long id : result) {
+            pos = lower_bound(pos, other.end(), id);
+            if (pos == other.end()) break;
+            if (*pos == id) result[kept++] = id;
+        }
+        result.resize(kept);
+    }
+    return result;
+}
+
+void SearchIndex::add(Video* v) {
+    long long id = v->getId().value();
+    catalog[id] = v;
+    if (ordered.empty() || ordered.back()->getId() < v->getId()) {
+        ordered.push_back(v);
+    } else {
+        auto pos = upper_bound(ordered.begin(), ordered.end(), v,
+                               [](const Video* a, const Video* b) { return a->getId() < b->getId(); });
+        ordered.insert(pos, v);
+    }
+    prefixes.add(v);
+
+    for (const string& tok : tokenize(v->getTitle())) {
+        auto& list = postings[tok];
+        if (list.empty()) fuzzy.addWord(tok);  // First time we see this word
+        appendId(list, id);
+    }
+
+    string low = toLower(v->getTitle());
+    for (size_t i = 0; i + 3 <= low.size(); ++i) {
+        appendId(trigrams[trigramKey(low, i)], id);
+    }
+
+    // Patch cached queries the new title matches instead of dropping them
+    for (auto& e : cache.all()) {
+        double text;
+        if (e.broad) continue;  // Ranked off the index, so already up to date
+        if (e.maxDist < 0) {
+            if (containsIgnoreCase(v->getTitle(), e.query)) {
+                e.matches.push_back({id, textScore(v->getTitle(), e.query)});
+            }
+        } else if (fuzzyTextScore(v->getTitle(), tokenize(e.query), e.maxDist, text)) {
+            e.matches.push_back({id, text});
+        }
+    }
+    cache.markBroad();
+}
+
+void SearchIndex::viewsChanged(Video* v) {
+    // Videos that were never uploaded (benchmark fixtures) must not leak into the trie
+    auto it = catalog.find(v->getId().value());
+    if (it != catalog.end() && it->second == v) prefixes.viewsChanged(v);
+}
+
+size_t SearchIndex::size() const { return catalog.size(); }
+
+void SearchIndex::setScanThreads(size_t threads) {
+    if (threads <= 1) pool.reset();
+    else pool = make_unique<ThreadPool>(threads);
+}
+
+size_t SearchIndex::scanThreads() const { return pool ? pool->size() : 1; }
+
+template <typename Fn>
+void SearchIndex::forEachMatch(const string& low, Fn&& fn) const {
+    // Too short to form a trigram, so fall back to checking every title
+    if (low.size() < 3) {
+        for (Video* v : ordered) {
+            if (containsIgnoreCase(v->getTitle(), low) && !fn(v)) return;
+        }
+        return;
+    }
+
+    vector<const vector<long long>*> lists;
+    unordered_set<uint32_t> seen;
+    for (size_t i = 0; i + 3 <= low.size(); ++i) {
+        uint32_t key = trigramKey(low, i);
+        if (!seen.insert(key).second) continue;
+        auto it = trigrams.find(key);
+        if (it == trigrams.end()) return;
+        lists.push_back(&it->second);
+    }
+
+    // Sharing every trigram doesn't guarantee a match, so verify the survivors
+    for (long long id : intersect(lists)) {
+        Video* v = catalog.at(id);
+        if (containsIgnoreCase(v->getTitle(), low) && !fn(v)) return;
+    }
+}
+
+double SearchIndex::textScore(const string& title, const string& low) {
+    if (low.empty() || title.empty()) return 0.0;
+
+    // Count non-overlapping occurrences and remember where the first one was
+    size_t first = findIgnoreCase(title, low);
+    int tf = 0;
+    for (size_t pos = first; pos != string::npos; pos = findIgnoreCase(title, low, pos + low.size())) {
+        ++tf;
+    }
+    double position = 1.0 - static_cast<double>(first) / static_cast<double>(title.size());
+    return WEIGHT_TF * tf + WEIGHT_POSITION * position;
+}
+
+double SearchIndex::popularity(const Video* v) {
+    return WEIGHT_VIEWS * log1p(static_cast<double>(v->getViews()));
+}
+
+bool SearchIndex::fuzzyTextScore(const string& title, const vector<string>& words, int maxDist, double& text) {
+    vector<string> titleWords = tokenize(title);
+    double sum = 0.0;
+    for (const string& w : words) {
+        int best = maxDist + 1;
+        for (const string& t : titleWords) best = min(best, FuzzyIndex::editDistance(w, t, maxDist));
+        if (best > maxDist) return false;
+        sum += 1.0 - static_cast<double>(best) / (maxDist + 1);
+    }
+    text = WEIGHT_TF * sum;
+    return true;
+}
+
+template <typename Fn>
+void SearchIndex::forEachShard(Fn&& fn) const {
+    size_t shards = pool->size();
+    size_t perShard = (ordered.size() + shards - 1) / shards;
+    vector<future<void>> pending;
+
+    for (size_t s = 0; s < shards; ++s) {
+        size_t begin = s * perShard;
+        size_t end = min(ordered.size(), begin + perShard);
+        if (begin >= end) break;
+        pending.push_back(pool->submit([&fn, begin, end, s] { fn(begin, end, s); }));
+    }
+    for (auto& p : pending) p.get();
+}
+
+vector<SearchHit> SearchIndex::scanSharded(const string& low, size_t k) const {
+    vector<vector<SearchHit>> partial(pool->size());
+    forEachShard([&](size_t begin, size_t end, size_t s) {
+        TopHits top(k);
+        for (size_t i = begin; i < end; ++i) {
+            Video* v = ordered[i];
+            if (containsIgnoreCase(v->getTitle(), low)) {
+                top.offer({v, textScore(v->getTitle(), low) + popularity(v)});
+            }
+        }
+        partial[s] = top.take();
+    });
+
+    // Each shard already holds its own best k, so merging only sees shards * k hits
+    TopHits merged(k);
+    for (const auto& hits : partial) {
+        for (const SearchHit& h : hits) merged.offer(h);
+    }
+    return merged.take();
+}
+
+bool SearchIndex::scansSharded(const string& low) const {
+    return pool && low.size() < 3 && ordered.size() >= PARALLEL_SCAN_MIN;
+}
+
+vector<SearchHit> SearchIndex::searchRanked(const string& query, size_t k) const {
+    string low = toLower(query);
+    if (scansSharded(low)) return scanSharded(low, k);
+
+    TopHits top(k);
+    forEachMatch(low, [&](Video* v) {
+        top.offer({v, textScore(v->getTitle(), low) + popularity(v)});
+        return true;
+    });
+    return top.take();
+}
+
+bool SearchIndex::collectSubstring(const string& low, vector<TitleMatch>& out) const {
+    forEachMatch(low, [&](Video* v) {
+        out.push_back({v->getId().value(), textScore(v->getTitle(), low)});
+        return out.size() <= QueryCache::MAX_MATCHES;
+    });
+    return out.size() <= QueryCache::MAX_MATCHES;
+}
+
+vector<TitleMatch> SearchIndex::collectFuzzy(const vector<string>& words, int maxDist) const {
+    // video ID -> summed closeness over the query words matched so far;
+    // a video drops out as soon as one query word has no close title word
+    unordered_map<long long, double> matched;
+    for (size_t qi = 0; qi < words.size(); ++qi) {
+        unordered_map<long long, double> best;
+        for (const auto& cand : fuzzy.lookup(words[qi], maxDist)) {
+            double closeness = 1.0 - static_cast<double>(cand.second) / (maxDist + 1);
+            for (long long id : postings.at(*cand.first)) {
+                double& b = best[id];
+                b = max(b, closeness);
+            }
+        }
+
+        if (qi == 0) {
+            matched.swap(best);
+            continue;
+        }
+        for (auto it = matched.begin(); it != matched.end();) {
+            auto hit = best.find(it->first);
+            if (hit == best.end()) {
+                it = matched.erase(it);
+            } else {
+                it->second += hit->second;
+                ++it;
+            }
+        }
+    }
+
+    vector<TitleMatch> out;
+    out.reserve(matched.size());
+    for (const auto& m : matched) out.push_back({m.first, WEIGHT_TF * m.second});
+    sort(out.begin(), out.end(), [](const TitleMatch& a, const TitleMatch& b) { return a.id < b.id; });
+    return out;
+}
+
+vector<TitleMatch> SearchIndex::collectKeywords(const vector<string>& words) const {
+    vector<const vector<long long>*> lists;
+    for (const string& w : words) {
+        auto it = postings.find(w);
+        if (it == postings.end()) return {};  // One missing word means no match
+        lists.push_back(&it->second);
+    }
+    // Every word matched exactly, which scores what an exact fuzzy match would
+    double text = WEIGHT_TF * static_cast<double>(words.size());
+    vector<TitleMatch> out;
+    for (long long id : intersect(lists)) out.push_back({id, text});
+    return out;
+}
+
+vector<TitleMatch> SearchIndex::collectWords(const vector<string>& words, int maxDist) const {
+    return maxDist == 0 ? collectKeywords(words) : collectFuzzy(words, maxDist);
+}
+
+vector<SearchHit> SearchIndex::rank(const vector<TitleMatch>& matches, size_t k) const {
+    TopHits top(k);
+    for (const TitleMatch& m : matches) {
+        Video* v = catalog.at(m.id);
+        top.offer({v, m.text + popularity(v)});
+    }
+    return top.take();
+}
+
+vector<SearchHit> SearchIndex::search(const string& input, size_t k) {
+    QueryCache::Entry e;
+    e.query = toLower(input);
+    e.maxDist = -1;
+
+    size_t tilde = input.rfind('~');
+    if (tilde != string::npos) {
+        string rest = input.substr(tilde + 1);
+        // A '~' that is part of the text rather than a flag stays in the query
+        if (rest.empty() || (rest.size() == 1 && isdigit(static_cast<unsigned char>(rest[0])))) {
+            vector<string> words = tokenize(input.substr(0, tilde));
+            if (!words.empty()) {
+                int dist = rest.empty() ? FuzzyIndex::MAX_DISTANCE : rest[0] - '0';
+                e.maxDist = min(dist, FuzzyIndex::MAX_DISTANCE);
+                e.query.clear();
+                for (const string& w : words) e.query += (e.query.empty() ? "" : " ") + w;
+            }
+        }
+    }
+    e.key = (e.maxDist < 0 ? string("s:") : "f" + to_string(e.maxDist) + ":") + e.query;
+
+    if (QueryCache::Entry* cached = cache.find(e.key)) {
+        if (!cached->broad) return rank(cached->matches, k);
+        return cached->maxDist < 0 ? searchRanked(cached->query, k)
+                                   : rank(collectWords(tokenize(cached->query), cached->maxDist), k);
+    }
+
+    if (e.maxDist < 0) {
+        // Sharded scans merge per-shard top-K lists, which beats collecting every match
+        e.broad = scansSharded(e.query) || !collectSubstring(e.query, e.matches);
+    } else {
+        e.matches = collectWords(tokenize(e.query), e.maxDist);
+        e.broad = e.matches.size() > QueryCache::MAX_MATCHES;
+    }
+    if (!e.broad) return rank(cache.insert(move(e)).matches, k);
+
+    // Broad queries keep only the flag, so repeats skip straight to the bounded ranking
+    vector<SearchHit> hits = e.maxDist < 0 ? searchRanked(e.query, k) : rank(e.matches, k);
+    vector<TitleMatch>().swap(e.matches);
+    cache.insert(move(e));
+    return hits;
+}
+
+const QueryCache& SearchIndex::queryCache() const { return cache; }
+
+vector<Video*> SearchIndex::suggest(const string& prefix, size_t n) const {
+    return prefixes.complete(prefix, n);
+}
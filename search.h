@@ -0,0 +1,198 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "video.h"
+#include "threadpool.h"
+#include <list>
+
+// Trie over lowercase title words for prefix completion. Every node caches the
+// most viewed videos below it, so a lookup is just a walk down the prefix.
+class PrefixIndex {
+private:
+    struct Node {
+        vector<pair<char, uint32_t>> children;  // Sorted by character
+        vector<Video*> top;                     // Most viewed first, at most LIMIT
+    };
+    vector<Node> nodes;  // nodes[0] is the root
+
+    uint32_t child(uint32_t node, char ch, bool create);
+    void offer(uint32_t node, Video* v);
+    void walk(Video* v, bool create);
+
+public:
+    static const size_t LIMIT = 10;
+
+    PrefixIndex();
+
+    void add(Video* v);
+    void viewsChanged(Video* v);
+    vector<Video*> complete(const string& prefix, size_t n) const;
+};
+
+// One ranked search result
+struct SearchHit {
+    Video* video;
+    double score;
+};
+
+// Bounded min-heap that keeps only the k best hits offered to it
+class TopHits {
+private:
+    size_t k;
+    vector<SearchHit> heap;  // Root is the weakest hit still kept
+
+public:
+    explicit TopHits(size_t k);
+
+    void offer(const SearchHit& h);
+    vector<SearchHit> take();  // Best first; leaves the heap empty
+
+    // Higher score wins; ties go to the older (lower ID) video
+    static bool better(const SearchHit& a, const SearchHit& b);
+};
+
+// Symmetric-delete index over title words for typo-tolerant lookups
+class FuzzyIndex {
+private:
+    vector<string> words;
+    // Deletion variant -> word IDs; a query probes only its own variants
+    unordered_map<string, vector<uint32_t>> deletes;
+
+    static void variants(const string& word, int budget, unordered_set<string>& out);
+
+public:
+    static constexpr int MAX_DISTANCE = 2;
+    // Words are indexed by deleting up to MAX_DISTANCE characters from this many leading
+    // ones, so long words cost no more than short ones; candidates are checked in full
+    static constexpr size_t PREFIX_LENGTH = 7;
+
+    void addWord(const string& word);
+    // Indexed words within maxDist edits of the query word, with their distance
+    vector<pair<const string*, int>> lookup(const string& word, int maxDist) const;
+
+    // Levenshtein distance, or maxDist + 1 as soon as it is known to exceed maxDist
+    static int editDistance(const string& a, const string& b, int maxDist);
+};
+
+// A matching video with the part of its score that depends only on the title
+struct TitleMatch {
+    long long id;
+    double text;
+};
+
+// LRU cache of normalized query -> matching videos with their title scores
+class QueryCache {
+public:
+    struct Entry {
+        string key;
+        string query;  // Lowercased query; just the words for fuzzy queries
+        int maxDist;   // Allowed typos per word, or -1 for a substring query
+        // Views are applied when ranking, so plays never make these stale;
+        // SearchIndex::add appends the uploads that match
+        vector<TitleMatch> matches;
+        bool broad = false;  // Over MAX_MATCHES: no matches kept, hits rank off the index
+    };
+
+private:
+    list<Entry> entries;  // Most recently used first
+    unordered_map<string, list<Entry>::iterator> byKey;
+    size_t capacity;
+    long long hits = 0;
+    long long misses = 0;
+
+public:
+    static const size_t MAX_MATCHES = 1000;
+
+    explicit QueryCache(size_t capacity = 256);
+
+    // Counts a hit or miss; a hit becomes the most recently used entry
+    Entry* find(const string& key);
+    Entry& insert(Entry e);
+    list<Entry>& all();
+    // Turns entries that grew past MAX_MATCHES into broad ones
+    void markBroad();
+
+    long long getHits() const;
+    long long getMisses() const;
+    size_t size() const;
+};
+
+// Inverted indexes over video titles so searches don't have to scan every video.
+// Channel::upload feeds it, so it always mirrors the uploaded catalog.
+class SearchIndex {
+private:
+    // token -> IDs of videos whose title contains it, kept in ascending order
+    unordered_map<string, vector<long long>> postings;
+    // packed lowercase trigram -> IDs of videos whose title contains it
+    unordered_map<uint32_t, vector<long long>> trigrams;
+    unordered_map<long long, Video*> catalog;
+    vector<Video*> ordered;  // Same videos in ID order, for scans
+    PrefixIndex prefixes;
+    FuzzyIndex fuzzy;
+    unique_ptr<ThreadPool> pool;  // Set when full scans may be split across threads
+    QueryCache cache;
+
+    static vector<long long> intersect(vector<const vector<long long>*>& lists);
+    static void appendId(vector<long long>& list, long long id);
+    static uint32_t trigramKey(const string& s, size_t pos);
+    static double textScore(const string& title, const string& lowQuery);
+    static double popularity(const Video* v);
+    static bool fuzzyTextScore(const string& title, const vector<string>& words, int maxDist, double& text);
+
+    // Calls fn for every video whose title contains the lowercase query,
+    // stopping early once fn returns false
+    template <typename Fn>
+    void forEachMatch(const string& lowQuery, Fn&& fn) const;
+    // Runs fn(begin, end, shard) over contiguous ID ranges of the catalog on the pool
+    template <typename Fn>
+    void forEachShard(Fn&& fn) const;
+    vector<SearchHit> scanSharded(const string& lowQuery, size_t k) const;
+    // Short queries over a big catalog scan every title, split across the pool
+    bool scansSharded(const string& lowQuery) const;
+
+    // False (with out incomplete) once more than MAX_MATCHES videos match
+    bool collectSubstring(const string& lowQuery, vector<TitleMatch>& out) const;
+    vector<TitleMatch> collectFuzzy(const vector<string>& words, int maxDist) const;
+    // Videos with every word in the title, by intersecting posting lists
+    vector<TitleMatch> collectKeywords(const vector<string>& words) const;
+    // Keyword intersection for maxDist 0, the fuzzy index otherwise
+    vector<TitleMatch> collectWords(const vector<string>& words, int maxDist) const;
+    vector<SearchHit> rank(const vector<TitleMatch>& matches, size_t k) const;
+
+public:
+    // Relevance weights: matches in the title, how early the first one is, log(views)
+    static constexpr double WEIGHT_TF = 2.0;
+    static constexpr double WEIGHT_POSITION = 1.5;
+    static constexpr double WEIGHT_VIEWS = 0.5;
+    static const size_t DEFAULT_TOP_K = 10;
+    // Below this many videos a scan is cheaper than handing it to the pool
+    static const size_t PARALLEL_SCAN_MIN = 10000;
+
+    void add(Video* v);
+    void viewsChanged(Video* v);
+    size_t size() const;
+
+    // Threads used for scans that the trigram index can't serve; 0 or 1 keeps them inline
+    void setScanThreads(size_t threads);
+    size_t scanThreads() const;
+
+    // Videos whose title contains the query as a case-insensitive substring, scored
+    // for relevance without the cache; only the best k are kept, best first
+    vector<SearchHit> searchRanked(const string& query, size_t k = DEFAULT_TOP_K) const;
+    // Entry point for option 11: "words~N" searches with up to N typos per
+    // word (bare "~" means 2, "~0" whole words only), anything else is a
+    // ranked substring search.
+    // Match lists are served from the query cache when possible.
+    vector<SearchHit> search(const string& input, size_t k = DEFAULT_TOP_K);
+    const QueryCache& queryCache() const;
+    // Most viewed videos with a title word starting with the prefix
+    vector<Video*> suggest(const string& prefix, size_t n = PrefixIndex::LIMIT) const;
+
+    static string toLower(const string& s);
+    static vector<string> tokenize(const string& text);
+};
+
+// Process-wide index kept up to date by Channel::upload
+extern SearchIndex SEARCH_INDEX;
+
+#endif
@@ -0,0 +1,107 @@
+#include "session.h"
+
+SessionPool SESSION_POOL;
+
+static long long steadyMs() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// SessionPool implementation
+OpResult SessionPool::start(const string& user, Video* v) {
+    return start(AuthorPool::intern(user), v);
+}
+
+OpResult SessionPool::start(uint32_t user, Video* v) {
+    if (!v) return OpResult(OpStatus::NOT_FOUND, "Video not found");
+
+    uint32_t slot;
+    if (freeHead != NO_SLOT) {
+        slot = freeHead;
+        freeHead = slots[slot].nextFree;
+    } else {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+
+    Slot& s = slots[slot];
+    s.live = true;
+    s.nextFree = NO_SLOT;
+    long long serial = IdGen::next(IdKind::SESSION) & 0x7fffffffLL;
+    s.session = {SessionId((serial << 32) | slot), v, user, 0, PlaybackState::PLAYING, steadyMs()};
+    ++live;
+    return OpResult(OpStatus::SUCCESS, "Session started", s.session.id.value());
+}
+
+uint32_t SessionPool::slotOf(SessionId sessionId) {
+    return static_cast<uint32_t>(sessionId.value() & 0xffffffffLL);
+}
+
+bool SessionPool::isCurrent(SessionId sessionId) const {
+    if (!sessionId.valid() || slotOf(sessionId) >= slots.size()) return false;
+    const Slot& s = slots[slotOf(sessionId)];
+    return s.live && s.session.id == sessionId;
+}
+
+PlaybackSession* SessionPool::current(SessionId sessionId) {
+    return isCurrent(sessionId) ? &slots[slotOf(sessionId)].session : nullptr;
+}
+
+const PlaybackSession* SessionPool::find(SessionId sessionId) const {
+    return isCurrent(sessionId) ? &slots[slotOf(sessionId)].session : nullptr;
+}
+
+OpResult SessionPool::end(SessionId sessionId) {
+    if (!isCurrent(sessionId)) return OpResult(OpStatus::NOT_FOUND, "Session not found");
+
+    uint32_t slot = slotOf(sessionId);
+    Slot& s = slots[slot];
+    s.live = false;
+    s.nextFree = freeHead;
+    freeHead = slot;
+    --live;
+    return OpResult(OpStatus::SUCCESS, "Session ended");
+}
+
+OpResult SessionPool::pause(SessionId sessionId) {
+    PlaybackSession* s = current(sessionId);
+    if (!s) return OpResult(OpStatus::NOT_FOUND, "Session not found");
+    if (s->state == PlaybackState::PAUSED) {
+        return OpResult(OpStatus::INVALID_INPUT, "Not playing \"" + s->video->getTitle() + "\"");
+    }
+    s->positionSec = position(*s);
+    s->state = PlaybackState::PAUSED;
+    return OpResult(OpStatus::SUCCESS, "Paused \"" + s->video->getTitle() + "\" at " +
+                    to_string(s->positionSec) + "s");
+}
+
+OpResult SessionPool::resume(SessionId sessionId) {
+    PlaybackSession* s = current(sessionId);
+    if (!s) return OpResult(OpStatus::NOT_FOUND, "Session not found");
+    if (s->state == PlaybackState::PLAYING) {
+        return OpResult(OpStatus::ALREADY_EXISTS, "Already playing \"" + s->video->getTitle() + "\"");
+    }
+    s->state = PlaybackState::PLAYING;
+    s->playingSinceMs = steadyMs();
+    return OpResult(OpStatus::SUCCESS, "Resumed \"" + s->video->getTitle() + "\" at " +
+                    to_string(s->positionSec) + "s");
+}
+
+OpResult SessionPool::seek(SessionId sessionId, uint32_t positionSec) {
+    PlaybackSession* s = current(sessionId);
+    if (!s) return OpResult(OpStatus::NOT_FOUND, "Session not found");
+    if (positionSec > static_cast<uint32_t>(max(0, s->video->getDuration()))) {
+        return OpResult(OpStatus::INVALID_INPUT, "Position is past the end of the video");
+    }
+    s->positionSec = positionSec;
+    s->playingSinceMs = steadyMs();
+    return OpResult(OpStatus::SUCCESS, "Moved to " + to_string(positionSec) + "s");
+}
+
+uint32_t SessionPool::position(const PlaybackSession& s) {
+    long long pos = s.positionSec;
+    if (s.state == PlaybackState::PLAYING) pos += (steadyMs() - s.playingSinceMs) / 1000;
+    return static_cast<uint32_t>(min(pos, static_cast<long long>(max(0, s.video->getDuration()))));
+}
+
+size_t SessionPool::activeSessions() const { return live; }
+size_t SessionPool::capacity() const { return slots.size(); }
@@ -0,0 +1,56 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "video.h"
+
+enum class PlaybackState { PLAYING, PAUSED };
+
+// One viewer's playback of one video
+struct PlaybackSession {
+    SessionId id;
+    Video* video;
+    uint32_t user;         // AuthorPool handle
+    uint32_t positionSec;  // As of playingSinceMs while playing; use SessionPool::position
+    PlaybackState state;
+    long long playingSinceMs;  // Steady-clock ms of the last start, resume or seek
+};
+
+// Slab of playback sessions with O(1) start and end; not thread-safe
+class SessionPool {
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    struct Slot {
+        PlaybackSession session;
+        uint32_t nextFree = NO_SLOT;
+        bool live = false;
+    };
+    vector<Slot> slots;
+    uint32_t freeHead = NO_SLOT;  // Ended slots, reused before the slab grows
+    size_t live = 0;
+
+    // Session IDs pack a serial above the slot index, so a stale ID never finds the next occupant
+    static uint32_t slotOf(SessionId sessionId);
+    bool isCurrent(SessionId sessionId) const;
+    PlaybackSession* current(SessionId sessionId);
+
+public:
+    // Opens a session at the start of the video; the result id is the session ID
+    OpResult start(const string& user, Video* v);
+    OpResult start(uint32_t user, Video* v);  // user is an AuthorPool handle
+    OpResult end(SessionId sessionId);
+    OpResult pause(SessionId sessionId);
+    OpResult resume(SessionId sessionId);
+    OpResult seek(SessionId sessionId, uint32_t positionSec);
+    // Where playback is now: the stored position plus time spent playing since
+    static uint32_t position(const PlaybackSession& s);
+    // Null once the session has ended. Valid until the next start().
+    const PlaybackSession* find(SessionId sessionId) const;
+
+    size_t activeSessions() const;
+    size_t capacity() const;
+};
+
+// Process-wide sessions, opened by User::watch
+extern SessionPool SESSION_POOL;
+
+#endif
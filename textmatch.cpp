@@ -0,0 +1,135 @@
+#include "textmatch.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Kernels return the offset of the first match or string::npos
+typedef size_t (*MatchFn)(const char* h, size_t n, const char* p, size_t m);
+
+static inline char foldAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+}
+
+// Compares m bytes of h (folded) against the lowercase pattern p
+static inline bool equalsFolded(const char* h, const char* p, size_t m) {
+    for (size_t i = 0; i < m; ++i) {
+        if (foldAscii(h[i]) != p[i]) return false;
+    }
+    return true;
+}
+
+static size_t matchScalar(const char* h, size_t n, const char* p, size_t m) {
+    for (size_t i = 0; i + m <= n; ++i) {
+        if (foldAscii(h[i]) == p[0] && equalsFolded(h + i + 1, p + 1, m - 1)) return i;
+    }
+    return string::npos;
+}
+
+// Finishes a vector scan from offset i with the byte loop
+static inline size_t matchTail(const char* h, size_t n, const char* p, size_t m, size_t i) {
+    size_t pos = matchScalar(h + i, n - i, p, m);
+    return pos == string::npos ? pos : i + pos;
+}
+
+#if defined(__SSE2__)
+// Lowercases A-Z in a block; bytes >= 0x80 compare as negative and stay untouched
+static inline __m128i fold16(__m128i v) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+// Filters candidate positions by comparing the first and last pattern bytes
+// across a whole block, then verifies only the positions where both matched.
+// Advances i past the blocks it covered; the caller finishes the tail.
+static inline size_t scanBlocks16(const char* h, size_t n, const char* p, size_t m, size_t& i) {
+    const __m128i first = _mm_set1_epi8(p[0]);
+    const __m128i last = _mm_set1_epi8(p[m - 1]);
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i)));
+        __m128i b = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i + m - 1)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (equalsFolded(h + i + bit + 1, p + 1, m - 1)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return string::npos;
+}
+
+static size_t matchSse2(const char* h, size_t n, const char* p, size_t m) {
+    size_t i = 0;
+    size_t pos = scanBlocks16(h, n, p, m, i);
+    return pos != string::npos ? pos : matchTail(h, n, p, m, i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fold32(__m256i v) {
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+static size_t matchAvx2(const char* h, size_t n, const char* p, size_t m) {
+    const __m256i first = _mm256_set1_epi8(p[0]);
+    const __m256i last = _mm256_set1_epi8(p[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i)));
+        __m256i b = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i + m - 1)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (equalsFolded(h + i + bit + 1, p + 1, m - 1)) {
+                _mm256_zeroupper();
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    // Clear the upper lanes on every exit; the compiler misses some, and dirty
+    // lanes make SSE code in the caller (libm included) run far slower
+    _mm256_zeroupper();
+    // The 16-byte pass is inlined here so it is VEX-encoded too
+    size_t pos = scanBlocks16(h, n, p, m, i);
+    return pos != string::npos ? pos : matchTail(h, n, p, m, i);
+}
+#endif
+
+struct Kernel {
+    MatchFn fn;
+    const char* name;
+};
+
+// Resolved once on first use from what the running CPU supports
+static const Kernel& kernel() {
+    static const Kernel k = []() -> Kernel {
+#if defined(__SSE2__)
+        if (__builtin_cpu_supports("avx2")) return {matchAvx2, "avx2"};
+        return {matchSse2, "sse2"};
+#else
+        return {matchScalar, "scalar"};
+#endif
+    }();
+    return k;
+}
+
+size_t findIgnoreCase(const string& haystack, const string& lowerNeedle, size_t from) {
+    size_t m = lowerNeedle.size();
+    if (from > haystack.size()) return string::npos;
+    if (m == 0) return from;
+    if (m > haystack.size() - from) return string::npos;
+    size_t pos = kernel().fn(haystack.data() + from, haystack.size() - from, lowerNeedle.data(), m);
+    return pos == string::npos ? pos : from + pos;
+}
+
+bool containsIgnoreCase(const string& haystack, const string& lowerNeedle) {
+    return findIgnoreCase(haystack, lowerNeedle) != string::npos;
+}
+
+const char* textMatchKernel() { return kernel().name; }
@@ -0,0 +1,21 @@
+#ifndef TEXTMATCH_H
+#define TEXTMATCH_H
+
+#include <string>
+
+using namespace std;
+
+// ASCII case-insensitive substring test that reads the haystack in place,
+// so scans don't need a lowercased copy of every title.
+// The needle must already be lowercase. Uses AVX2 or SSE2 when the CPU has
+// them and falls back to a plain byte loop otherwise.
+bool containsIgnoreCase(const string& haystack, const string& lowerNeedle);
+
+// Same search, returning the offset of the first match at or after `from`
+// (string::npos if there is none)
+size_t findIgnoreCase(const string& haystack, const string& lowerNeedle, size_t from = 0);
+
+// Name of the kernel picked for this CPU ("avx2", "sse2" or "scalar")
+const char* textMatchKernel();
+
+#endif
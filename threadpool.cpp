@@ -0,0 +1,47 @@
+#include "threadpool.h"
+
+// ThreadPool implementation
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = 1;
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& w : workers) w.join();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        packaged_task<void()> task;
+        {
+            unique_lock<mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping || !tasks.empty(); });
+            // Drain what is queued before shutting down so no future is left hanging
+            if (tasks.empty()) return;
+            task = move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+future<void> ThreadPool::submit(function<void()> task) {
+    packaged_task<void()> wrapped(move(task));
+    future<void> done = wrapped.get_future();
+    {
+        lock_guard<mutex> guard(lock);
+        tasks.push(move(wrapped));
+    }
+    ready.notify_one();
+    return done;
+}
+
+size_t ThreadPool::size() const { return workers.size(); }
@@ -0,0 +1,37 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of worker threads that run submitted tasks in FIFO order
+class ThreadPool {
+private:
+    vector<thread> workers;
+    queue<packaged_task<void()>> tasks;
+    mutex lock;
+    condition_variable ready;
+    bool stopping = false;
+
+    void workerLoop();
+
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a task; the future becomes ready when it has run
+    future<void> submit(function<void()> task);
+    size_t size() const;
+};
+
+#endif
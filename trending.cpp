@@ -0,0 +1,58 @@
+#include "trending.h"
+#include <cmath>
+
+TrendingIndex TRENDING;
+
+// TrendingIndex implementation
+TrendingIndex::TrendingIndex(double halfLifeSec)
+    : rate(log(2.0) / halfLifeSec), landmark(nowSeconds()) {}
+
+void TrendingIndex::add(Video* v) { scores.emplace(v->getId(), 0.0); }
+
+void TrendingIndex::recordPlay(Video* v) { recordPlay(v, nowSeconds()); }
+
+void TrendingIndex::recordPlay(Video* v, double nowSec) {
+    auto it = scores.find(v->getId());
+    if (it == scores.end()) return;
+
+    double exponent = rate * (nowSec - landmark);
+    if (exponent > MAX_EXPONENT) {
+        rebase(nowSec);
+        exponent = 0;
+    }
+    it->second += exp(exponent);
+    offer(v, it->second);
+}
+
+void TrendingIndex::rebase(double nowSec) {
+    // Scaling every score by the same factor keeps the order, so the top list stays valid
+    double factor = exp(-rate * (nowSec - landmark));
+    for (auto& entry : scores) entry.second *= factor;
+    for (TrendingEntry& e : top) e.score *= factor;
+    landmark = nowSec;
+}
+
+void TrendingIndex::offer(Video* v, double score) {
+    offerMonotone(top, LIMIT, TrendingEntry{v, score},
+                  [](const TrendingEntry& a, const TrendingEntry& b) { return a.video == b.video; },
+                  [](const TrendingEntry& e) { return e.score; });
+}
+
+double TrendingIndex::score(const Video* v, double nowSec) const {
+    auto it = scores.find(v->getId());
+    if (it == scores.end()) return 0;
+    return it->second * exp(-rate * (nowSec - landmark));
+}
+
+vector<TrendingEntry> TrendingIndex::trending(size_t k, double nowSec) const {
+    double factor = exp(-rate * (nowSec - landmark));
+    vector<TrendingEntry> out;
+    for (size_t i = 0; i < top.size() && i < k; ++i) out.push_back({top[i].video, top[i].score * factor});
+    return out;
+}
+
+size_t TrendingIndex::size() const { return scores.size(); }
+
+double TrendingIndex::nowSeconds() {
+    return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,50 @@
+#ifndef TRENDING_H
+#define TRENDING_H
+
+#include "video.h"
+
+// One entry of the trending list
+struct TrendingEntry {
+    Video* video;
+    double score;  // Plays, each worth 1 when it happened and halving every half-life
+};
+
+// Trending videos by exponentially decayed play counts, using forward decay
+class TrendingIndex {
+private:
+    double rate;      // ln 2 / half-life
+    // Time the stored scores are relative to: a play at t adds exp(rate * (t - landmark)),
+    // so stored scores only grow and the top list never needs re-sorting
+    double landmark;
+    unordered_map<VideoId, double> scores;  // Video ID -> stored score
+    vector<TrendingEntry> top;                // Best first, at most LIMIT, stored scores
+
+    void rebase(double nowSec);
+    void offer(Video* v, double score);
+
+public:
+    static const size_t LIMIT = 10;
+    static constexpr double DEFAULT_HALF_LIFE_SEC = 6 * 3600;
+    // Past this exponent stored scores get rescaled before they can overflow
+    static constexpr double MAX_EXPONENT = 500;
+
+    explicit TrendingIndex(double halfLifeSec = DEFAULT_HALF_LIFE_SEC);
+
+    // Only added videos are tracked; plays of anything else are ignored
+    void add(Video* v);
+    // Not thread-safe; Video::play calls it from the command loop
+    void recordPlay(Video* v);
+    void recordPlay(Video* v, double nowSec);
+
+    double score(const Video* v, double nowSec) const;
+    // Up to k (at most LIMIT) hottest videos with scores as of nowSec, read in O(k)
+    vector<TrendingEntry> trending(size_t k, double nowSec) const;
+    size_t size() const;
+
+    static double nowSeconds();
+};
+
+// Process-wide trending list, fed by Channel::upload and Video::play
+extern TrendingIndex TRENDING;
+
+#endif
@@ -1,7 +1,7 @@
 #include "user.h"
 
-User::User() = default;
-User::User(const string& n): username(n) {}
+User::User() : author(AuthorPool::intern(username)) {}
+User::User(const string& n): username(n), author(AuthorPool::intern(n)) {}
 
 const string& User::getUsername() const { return username; }
 
@@ -9,15 +9,44 @@ OpResult User::watch(Video* v) {
     if (!v) return OpResult(OpStatus::NOT_FOUND, "Video not found");
     
     historyIds.push_back(v->getId());
+    stopWatching();
+    sessionId = SessionId(SESSION_POOL.start(author, v).id);
+    v->recordViewer(username);
     return v->play();
 }
 
+OpResult User::stopWatching() {
+    if (!sessionId.valid()) return OpResult(OpStatus::INVALID_INPUT, "Not watching anything");
+    OpResult result = SESSION_POOL.end(sessionId);
+    sessionId = SessionId();
+    return result;
+}
+
+OpResult User::togglePause() {
+    const PlaybackSession* s = SESSION_POOL.find(sessionId);
+    if (!s) return OpResult(OpStatus::INVALID_INPUT, "Not watching anything");
+    return s->state == PlaybackState::PLAYING ? SESSION_POOL.pause(sessionId)
+                                              : SESSION_POOL.resume(sessionId);
+}
+
+OpResult User::seek(uint32_t positionSec) {
+    if (!SESSION_POOL.find(sessionId)) return OpResult(OpStatus::INVALID_INPUT, "Not watching anything");
+    return SESSION_POOL.seek(sessionId, positionSec);
+}
+
+const PlaybackSession* User::nowWatching() const { return SESSION_POOL.find(sessionId); }
+
 OpResult User::addComment(Video* v, const string& text) {
     if (!v) return OpResult(OpStatus::NOT_FOUND, "Video not found");
-    return v->addComment(username, text);
+    return v->addComment(author, text);
+}
+
+OpResult User::addReply(Video* v, CommentId parentId, const string& text) {
+    if (!v) return OpResult(OpStatus::NOT_FOUND, "Video not found");
+    return v->addReply(author, parentId, text);
 }
 
-OpResult User::likeComment(Video* v, long long cid) {
+OpResult User::likeComment(Video* v, CommentId cid) {
     if (!v) return OpResult(OpStatus::NOT_FOUND, "Video not found");
     return v->likeComment(cid);
 }
@@ -26,8 +55,8 @@ OpResult User::createPlaylist(const string& pname) {
     if (playlists.find(pname) != playlists.end()) {
         return OpResult(OpStatus::ALREADY_EXISTS, "Playlist exists");
     }
-    playlists.emplace(pname, Playlist(pname));
-    return OpResult(OpStatus::SUCCESS, "Created playlist \"" + pname + "\"");
+    auto it = playlists.emplace(pname, Playlist(pname)).first;
+    return OpResult(OpStatus::SUCCESS, "Created playlist \"" + pname + "\"", it->second.getId().value());
 }
 
 Playlist* User::getPlaylist(const string& pname) {
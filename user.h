@@ -1,15 +1,17 @@
 #ifndef USER_H
 #define USER_H
 
-#include "video.h"
+#include "session.h"
 
 // User can watch videos, comment, and manage playlists
 class User {
 private:
     string username;
+    uint32_t author;  // AuthorPool handle of username, interned once
     unordered_set<string> subscriptions;
-    vector<long long> historyIds;  // Track watch history by video ID
+    vector<VideoId> historyIds;  // Track watch history by video ID
     unordered_map<string, Playlist> playlists;
+    SessionId sessionId;  // What the user is watching now, in SESSION_POOL
 
 public:
     User();
@@ -17,9 +19,15 @@ public:
 
     const string& getUsername() const;
 
+    // Starts a playback session, ending the one already open
     OpResult watch(Video* v);
+    OpResult stopWatching();
+    OpResult togglePause();
+    OpResult seek(uint32_t positionSec);
+    const PlaybackSession* nowWatching() const;
     OpResult addComment(Video* v, const string& text);
-    OpResult likeComment(Video* v, long long cid);
+    OpResult addReply(Video* v, CommentId parentId, const string& text);
+    OpResult likeComment(Video* v, CommentId cid);
     OpResult createPlaylist(const string& pname);
     Playlist* getPlaylist(const string& pname);
     OpResult subscribeChannel(Channel& ch);
@@ -1,8 +1,11 @@
 #include "video.h"
+#include "search.h"
+#include "trending.h"
 
 bool PERF_LOGGING = false;
 
-atomic<long long> IdGen::counter{0LL};
+IdGen::Counter IdGen::counters[IdGen::KINDS];
+unique_ptr<SnowflakeGen> IdGen::snowflakes[IdGen::KINDS];
 
 // OpResult implementation
 OpResult::OpResult(OpStatus s, const string& m, long long i) 
@@ -26,9 +29,57 @@ PerfTimer::~PerfTimer() {
     }
 }
 
+// SnowflakeGen implementation
+SnowflakeGen::SnowflakeGen(long long nodeId) : node(nodeId & MAX_NODE) {}
+
+long long SnowflakeGen::next() {
+    long long nowMs = chrono::duration_cast<chrono::milliseconds>(
+                          chrono::system_clock::now().time_since_epoch()).count();
+    long long now = (nowMs - EPOCH_MS) << SEQUENCE_BITS;
+    long long prev = last.load(memory_order_relaxed);
+    long long stamp;
+    do {
+        // A full millisecond or a clock that stepped back just keeps counting up
+        stamp = max(now, prev + 1);
+    } while (!last.compare_exchange_weak(prev, stamp, memory_order_relaxed));
+
+    long long sequence = stamp & ((1LL << SEQUENCE_BITS) - 1);
+    return ((stamp >> SEQUENCE_BITS) << (NODE_BITS + SEQUENCE_BITS)) | (node << SEQUENCE_BITS) | sequence;
+}
+
+long long SnowflakeGen::timestampOf(long long id) { return (id >> (NODE_BITS + SEQUENCE_BITS)) + EPOCH_MS; }
+long long SnowflakeGen::nodeOf(long long id) { return (id >> SEQUENCE_BITS) & MAX_NODE; }
+long long SnowflakeGen::sequenceOf(long long id) { return id & ((1LL << SEQUENCE_BITS) - 1); }
+
 // IdGen implementation
-long long IdGen::next() { 
-    return ++counter; 
+OpResult IdGen::useSnowflake(long long node) {
+    if (node < 0 || node > SnowflakeGen::MAX_NODE) {
+        return OpResult(OpStatus::INVALID_INPUT,
+                        "Node ID must be between 0 and " + to_string(SnowflakeGen::MAX_NODE));
+    }
+    for (IdKind kind : {IdKind::VIDEO, IdKind::COMMENT, IdKind::PLAYLIST}) {
+        snowflakes[static_cast<size_t>(kind)] = make_unique<SnowflakeGen>(node);
+    }
+    return OpResult(OpStatus::SUCCESS, "Snowflake IDs from node " + to_string(node), node);
+}
+
+bool IdGen::snowflakeMode() { return snowflakes[static_cast<size_t>(IdKind::VIDEO)] != nullptr; }
+
+long long IdGen::next(IdKind kind) {
+    if (SnowflakeGen* gen = snowflakes[static_cast<size_t>(kind)].get()) return gen->next();
+
+    struct Block {
+        long long next = 0;
+        long long end = 0;  // One past the last reserved ID
+    };
+    static thread_local Block blocks[KINDS];
+
+    Block& b = blocks[static_cast<size_t>(kind)];
+    if (b.next == b.end) {
+        b.next = counters[static_cast<size_t>(kind)].value.fetch_add(BLOCK_SIZE, memory_order_relaxed) + 1;
+        b.end = b.next + BLOCK_SIZE;
+    }
+    return b.next++;
 }
 
 // Logger implementation
@@ -45,102 +96,685 @@ void Logger::info(const string& msg) { log(INFO, msg); }
 void Logger::warn(const string& msg) { log(WARNING, msg); }
 void Logger::error(const string& msg) { log(ERROR, msg); }
 
+// AuthorPool implementation
+atomic<string*> AuthorPool::chunks[size_t(1) << (32 - AuthorPool::CHUNK_BITS)];
+atomic<uint32_t> AuthorPool::count{0};
+unordered_map<string_view, uint32_t> AuthorPool::handles;
+mutex AuthorPool::lock;
+
+uint32_t AuthorPool::intern(const string& name) {
+    lock_guard<mutex> guard(lock);
+    auto it = handles.find(name);
+    if (it != handles.end()) return it->second;
+    uint32_t handle = count.load(memory_order_relaxed);
+    atomic<string*>& chunk = chunks[handle >> CHUNK_BITS];
+    if (!chunk.load(memory_order_relaxed)) chunk.store(new string[CHUNK_SIZE], memory_order_release);
+    string& slot = chunk.load(memory_order_relaxed)[handle & (CHUNK_SIZE - 1)];
+    slot = name;
+    handles.emplace(slot, handle);
+    count.store(handle + 1, memory_order_release);
+    return handle;
+}
+
+const string& AuthorPool::name(uint32_t handle) {
+    return chunks[handle >> CHUNK_BITS].load(memory_order_acquire)[handle & (CHUNK_SIZE - 1)];
+}
+
+size_t AuthorPool::size() { return count.load(memory_order_acquire); }
+
+// TextArena implementation
+uint32_t TextArena::append(string_view text) {
+    if (text.empty()) return static_cast<uint32_t>(used);
+
+    size_t capacity = windows.size() * BLOCK_SIZE;
+    size_t inWindow = used % BLOCK_SIZE;
+    if (used + text.size() > capacity || inWindow + text.size() > BLOCK_SIZE) {
+        // Start a fresh block at the next window; oversized text gets one block
+        // spanning several windows so it stays contiguous
+        used = capacity;
+        size_t span = (text.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        blocks.push_back(make_unique<char[]>(span * BLOCK_SIZE));
+        for (size_t i = 0; i < span; ++i) windows.push_back(blocks.back().get() + i * BLOCK_SIZE);
+    }
+
+    uint32_t offset = static_cast<uint32_t>(used);
+    copy(text.begin(), text.end(), windows[used / BLOCK_SIZE] + used % BLOCK_SIZE);
+    used += text.size();
+    stored += text.size();
+    return offset;
+}
+
+string_view TextArena::view(uint32_t offset, uint32_t length) const {
+    if (length == 0) return string_view();
+    return string_view(windows[offset / BLOCK_SIZE] + offset % BLOCK_SIZE, length);
+}
+
+size_t TextArena::bytesUsed() const { return stored; }
+size_t TextArena::bytesReserved() const { return windows.size() * BLOCK_SIZE; }
+
 // Comment implementation
+static_assert(sizeof(Comment) == 40, "Comment records are meant to stay at 40 bytes");
+
 Comment::Comment() = default;
 
-Comment::Comment(const string& a, const string& t)
-    : id(IdGen::next()), author(a), text(t), likes(0) {
-    ts = chrono::duration_cast<chrono::milliseconds>(
-             chrono::system_clock::now().time_since_epoch()).count();
+Comment::Comment(uint32_t authorHandle, uint32_t offset, uint32_t length, uint32_t secondsAfterVideo,
+                 uint32_t parentSlot)
+    : id(IdGen::next<CommentId>()), author(authorHandle), textOffset(offset), textLength(length),
+      likes(0), tsDelta(secondsAfterVideo), parent(parentSlot), replies(0), pending(0) {}
+
+Comment::Comment(const Comment& other)
+    : id(other.id), author(other.author), textOffset(other.textOffset), textLength(other.textLength),
+      likes(other.likes), tsDelta(other.tsDelta), parent(other.parent), replies(other.replies),
+      pending(other.pending.load(memory_order_relaxed)) {}
+
+Comment& Comment::operator=(const Comment& other) {
+    id = other.id;
+    author = other.author;
+    textOffset = other.textOffset;
+    textLength = other.textLength;
+    likes = other.likes;
+    tsDelta = other.tsDelta;
+    parent = other.parent;
+    replies = other.replies;
+    pending.store(other.pending.load(memory_order_relaxed), memory_order_relaxed);
+    return *this;
 }
 
-long long Comment::getId() const { return id; }
-const string& Comment::getAuthor() const { return author; }
-const string& Comment::getText() const { return text; }
+CommentId Comment::getId() const { return id; }
+const string& Comment::getAuthor() const { return AuthorPool::name(author); }
+string_view Comment::getText(const TextArena& arena) const {
+    return arena.view(textOffset, getTextLength());
+}
+uint32_t Comment::getTextOffset() const { return textOffset; }
+uint32_t Comment::getTextLength() const { return textLength & ~REMOVED_BIT; }
+long long Comment::getTimestamp(long long videoCreatedMs) const {
+    return videoCreatedMs + static_cast<long long>(tsDelta) * 1000;
+}
 int Comment::getLikes() const { return likes; }
+int Comment::getLikesExact() const { return likes + static_cast<int>(getPendingLikes()); }
+uint32_t Comment::getPendingLikes() const { return pending.load(memory_order_relaxed); }
 void Comment::like() { likes++; }
+// Relaxed is enough: the count carries no other data, and folding happens
+// after the liking threads have been joined or otherwise synchronized with
+void Comment::likeConcurrent() { pending.fetch_add(1, memory_order_relaxed); }
+uint32_t Comment::takePending() { return pending.exchange(0, memory_order_relaxed); }
+void Comment::addLikes(int delta) { likes += delta; }
+bool Comment::isRemoved() const { return (textLength & REMOVED_BIT) != 0; }
+void Comment::markRemoved() { textLength |= REMOVED_BIT; }
+void Comment::relocateText(uint32_t offset) { textOffset = offset; }
+bool Comment::isReply() const { return parent != NO_PARENT; }
+uint32_t Comment::getParentSlot() const { return parent; }
+void Comment::reparent(uint32_t slot) { parent = slot; }
+uint32_t Comment::getReplyCount() const { return replies; }
+void Comment::replyAdded() { replies++; }
+void Comment::replyRemoved() { replies--; }
+
+size_t CommentMemory::total() const {
+    return recordBytes + textBytes + indexBytes + rankingBytes + threadBytes;
+}
 
 // Video implementation
 Video::Video() = default;
 
 Video::Video(const string& t, const string& u, int d)
-    : id(IdGen::next()), title(t), uploader(u), durationSec(d), views(0), playing(false) {}
+    : Video(IdGen::next<VideoId>(), t, u, d) {}
+
+Video::Video(VideoId vid, const string& t, const string& u, int d)
+    : id(vid), title(t), uploader(u), durationSec(d) {
+    createdMs = chrono::duration_cast<chrono::milliseconds>(
+                    chrono::system_clock::now().time_since_epoch()).count();
+}
 
-long long Video::getId() const { return id; }
+VideoId Video::getId() const { return id; }
 const string& Video::getTitle() const { return title; }
 const string& Video::getUploader() const { return uploader; }
-long long Video::getViews() const { return views; }
+long long Video::getViews() const { return views.read(); }
+int Video::getDuration() const { return durationSec; }
 
 OpResult Video::play() {
     PerfTimer timer("Video::play", PERF_LOGGING);
     
-    if (!playing) {
-        playing = true;
-        ++views;
-        return OpResult(OpStatus::SUCCESS, 
-            "Playing \"" + title + "\" (views: " + to_string(views) + ")");
-    }
-    return OpResult(OpStatus::ALREADY_EXISTS, 
-        "Already playing \"" + title + "\"");
+    recordView();
+    foldViews();
+    SEARCH_INDEX.viewsChanged(this);  // Keeps autocomplete ranking current
+    TRENDING.recordPlay(this);
+    return OpResult(OpStatus::SUCCESS, 
+        "Playing \"" + title + "\" (views: " + to_string(getViews()) + ")");
 }
 
-OpResult Video::pause() {
-    if (playing) {
-        playing = false;
-        return OpResult(OpStatus::SUCCESS, "Paused \"" + title + "\"");
+void Video::recordView() { views.add(1); }
+
+void Video::foldViews() const {
+    long long total = views.read();
+    long long folded = timelineViews.load(memory_order_relaxed);
+    // Whoever moves the mark records the views it skipped; racing folders split them
+    while (total > folded) {
+        if (timelineViews.compare_exchange_weak(folded, total, memory_order_relaxed)) {
+            recentViews.record(ViewTimeline::nowSeconds(), total - folded);
+            return;
+        }
     }
-    return OpResult(OpStatus::INVALID_INPUT, "Not playing \"" + title + "\"");
+}
+
+void Video::recordViewer(const string& user) {
+    if (!viewers) viewers = make_unique<HyperLogLog>();
+    viewers->add(user);
+}
+
+long long Video::getUniqueViewers() const { return viewers ? viewers->estimate() : 0; }
+const HyperLogLog* Video::viewerSketch() const { return viewers.get(); }
+
+long long Video::getViewsInLast(ViewTimeline::Resolution r, size_t n) const {
+    foldViews();
+    return recentViews.count(r, n, ViewTimeline::nowSeconds());
+}
+
+uint32_t Video::storeComment(uint32_t author, const string& text, uint32_t parentSlot) {
+    long long nowMs = chrono::duration_cast<chrono::milliseconds>(
+                          chrono::system_clock::now().time_since_epoch()).count();
+    uint32_t offset = commentText.append(text);
+    comments.emplace_back(author, offset, static_cast<uint32_t>(text.size()),
+                          static_cast<uint32_t>(max(0LL, nowMs - createdMs) / 1000), parentSlot);
+    uint32_t slot = static_cast<uint32_t>(comments.size() - 1);
+    commentSlots[comments.back().getId()] = slot;
+    likeRank.push_back(NOT_RANKED);
+    return slot;
+}
+
+const Comment* Video::liveComment(CommentId cid, uint32_t* slot) const {
+    auto it = commentSlots.find(cid);
+    if (it == commentSlots.end() || comments[it->second].isRemoved()) return nullptr;
+    if (slot) *slot = it->second;
+    return &comments[it->second];
 }
 
 OpResult Video::addComment(const string& user, const string& text) {
+    return addComment(AuthorPool::intern(user), text);
+}
+
+OpResult Video::addComment(uint32_t author, const string& text) {
     PerfTimer timer("Video::addComment", PERF_LOGGING);
     
-    comments.emplace_back(user, text);
-    long long cid = comments.back().getId();
+    uint32_t slot = storeComment(author, text, Comment::NO_PARENT);
+    topLevel.push_back(slot);
+    // New comments have no likes, so they belong at the end of the ranking
+    likeRank[slot] = static_cast<uint32_t>(byLikes.size());
+    byLikes.push_back(slot);
+    return OpResult(OpStatus::SUCCESS, 
+        "Comment added by " + AuthorPool::name(author), comments[slot].getId().value());
+}
+
+OpResult Video::addReply(const string& user, CommentId parentId, const string& text) {
+    return addReply(AuthorPool::intern(user), parentId, text);
+}
+
+OpResult Video::addReply(uint32_t author, CommentId parentId, const string& text) {
+    PerfTimer timer("Video::addReply", PERF_LOGGING);
+
+    uint32_t parentSlot;
+    if (!liveComment(parentId, &parentSlot)) {
+        return OpResult(OpStatus::NOT_FOUND, "Comment not found");
+    }
+    // Store first: the append may reallocate comments
+    uint32_t slot = storeComment(author, text, parentSlot);
+    comments[parentSlot].replyAdded();
+    replySlots[parentSlot].push_back(slot);
     return OpResult(OpStatus::SUCCESS, 
-        "Comment added by " + user, cid);
+        "Reply added by " + AuthorPool::name(author), comments[slot].getId().value());
 }
 
-OpResult Video::likeComment(long long cid) {
+OpResult Video::likeComment(CommentId cid) {
     PerfTimer timer("Video::likeComment", PERF_LOGGING);
     
-    // We do a linear search here, could use a hash map if comment counts get huge
-    for (auto &c : comments) {
-        if (c.getId() == cid) {
-            c.like();
-            return OpResult(OpStatus::SUCCESS, 
-                "Liked comment " + to_string(cid) + " (likes=" + to_string(c.getLikes()) + ")");
+    uint32_t slot;
+    if (!liveComment(cid, &slot)) {
+        return OpResult(OpStatus::NOT_FOUND, "Comment not found");
+    }
+
+    Comment& c = comments[slot];
+    if (!c.isReply()) promote(slot);
+    c.like();
+    return OpResult(OpStatus::SUCCESS, 
+        "Liked comment " + to_string(cid.value()) + " (likes=" + to_string(c.getLikes()) + ")");
+}
+
+OpResult Video::likeCommentConcurrent(CommentId cid) {
+    // No PerfTimer or message on the success path; this is the hot one
+    uint32_t slot;
+    if (!liveComment(cid, &slot)) {
+        return OpResult(OpStatus::NOT_FOUND, "Comment not found");
+    }
+    comments[slot].likeConcurrent();
+    return OpResult(OpStatus::SUCCESS);
+}
+
+size_t Video::foldLikes() {
+    PerfTimer timer("Video::foldLikes", PERF_LOGGING);
+
+    vector<pair<uint32_t, int>> deltas;
+    size_t folded = 0;
+    for (size_t slot = 0; slot < comments.size(); ++slot) {
+        if (comments[slot].getPendingLikes() == 0) continue;
+        uint32_t n = comments[slot].takePending();
+        folded += n;
+        deltas.emplace_back(static_cast<uint32_t>(slot), static_cast<int>(n));
+    }
+    adjustLikes(deltas);
+    return folded;
+}
+
+size_t Video::applyLikes(const LikeEvent* events, size_t count) {
+    PerfTimer timer("Video::applyLikes", PERF_LOGGING);
+
+    // Net the batch out per comment first, so a burst on one comment
+    // moves it through the ranking once
+    vector<pair<uint32_t, int>> deltas;
+    deltas.reserve(count);
+    size_t applied = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t slot;
+        if (!liveComment(events[i].commentId, &slot)) continue;
+        deltas.emplace_back(slot, events[i].delta);
+        ++applied;
+    }
+    sort(deltas.begin(), deltas.end());
+    size_t merged = 0;
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        if (merged > 0 && deltas[merged - 1].first == deltas[i].first) {
+            deltas[merged - 1].second += deltas[i].second;
+        } else {
+            deltas[merged++] = deltas[i];
         }
     }
-    return OpResult(OpStatus::NOT_FOUND, "Comment not found");
+    deltas.resize(merged);
+    adjustLikes(deltas);
+    return applied;
 }
 
-OpResult Video::removeComment(long long cid, const string& requester, const string& channelOwner) {
-    for (auto it = comments.begin(); it != comments.end(); ++it) {
-        if (it->getId() == cid) {
-            // Only the comment author or channel owner can delete
-            if (requester == it->getAuthor() || requester == channelOwner) {
-                comments.erase(it);
-                return OpResult(OpStatus::SUCCESS, "Comment removed");
-            }
-            return OpResult(OpStatus::PERMISSION_DENIED, "Permission denied");
+void Video::adjustLikes(const vector<pair<uint32_t, int>>& deltas) {
+    // Past a point, moving every touched comment group by group costs more
+    // than one sort of the whole ranking
+    bool resort = deltas.size() * RESORT_FRACTION > byLikes.size();
+    for (const auto& d : deltas) {
+        Comment& c = comments[d.first];
+        // Tombstones are out of the ranking; their count no longer matters
+        if (c.isRemoved()) continue;
+        int change = max(d.second, -c.getLikes());  // Counts never go below zero
+        if (change == 0) continue;
+        if (!resort && !c.isReply()) {
+            if (change > 0) promote(d.first, change);
+            else demote(d.first, -change);
+        }
+        c.addLikes(change);
+    }
+    if (resort) {
+        stable_sort(byLikes.begin(), byLikes.end(), [this](uint32_t a, uint32_t b) {
+            return comments[a].getLikes() > comments[b].getLikes();
+        });
+        for (size_t pos = 0; pos < byLikes.size(); ++pos) {
+            likeRank[byLikes[pos]] = static_cast<uint32_t>(pos);
         }
     }
-    return OpResult(OpStatus::NOT_FOUND, "Comment not found");
 }
 
-void Video::listComments() const {
-    if (comments.empty()) {
+OpResult Video::removeComment(CommentId cid, const string& requester, const string& channelOwner) {
+    uint32_t slot;
+    if (!liveComment(cid, &slot)) {
+        return OpResult(OpStatus::NOT_FOUND, "Comment not found");
+    }
+
+    // Only the comment author or channel owner can delete
+    Comment& c = comments[slot];
+    if (requester != c.getAuthor() && requester != channelOwner) {
+        return OpResult(OpStatus::PERMISSION_DENIED, "Permission denied");
+    }
+
+    // Tombstone instead of erasing so later comments don't have to shift.
+    // The IDs stay indexed until compaction so page cursors on them still resume.
+    if (c.isReply()) comments[c.getParentSlot()].replyRemoved();
+    removedComments += removeThread(slot);
+    if (removedComments >= COMPACT_MIN_REMOVED && removedComments * 2 >= comments.size()) {
+        compactComments();
+    }
+    return OpResult(OpStatus::SUCCESS, "Comment removed");
+}
+
+size_t Video::removeThread(uint32_t slot) {
+    // Explicit stack so a deep reply chain can't overflow the call stack
+    size_t removed = 0;
+    vector<uint32_t> pending{slot};
+    while (!pending.empty()) {
+        uint32_t s = pending.back();
+        pending.pop_back();
+        if (comments[s].isRemoved()) continue;
+        comments[s].markRemoved();
+        ++removed;
+        auto it = replySlots.find(s);
+        if (it != replySlots.end()) {
+            pending.insert(pending.end(), it->second.begin(), it->second.end());
+        }
+    }
+    return removed;
+}
+
+void Video::compactComments() {
+    const uint32_t gone = UINT32_MAX;
+    vector<uint32_t> newSlot(comments.size(), gone);
+    size_t kept = 0;
+    for (size_t i = 0; i < comments.size(); ++i) {
+        if (comments[i].isRemoved()) {
+            commentSlots.erase(comments[i].getId());
+            continue;
+        }
+        if (kept != i) comments[kept] = move(comments[i]);
+        commentSlots[comments[kept].getId()] = kept;
+        newSlot[i] = static_cast<uint32_t>(kept);
+        ++kept;
+    }
+    comments.resize(kept);
+
+    // Copy the surviving text into a fresh arena so removed text is freed too.
+    // A live reply's parent is live too, since removal takes whole subtrees.
+    TextArena packed;
+    for (Comment& c : comments) {
+        c.relocateText(packed.append(c.getText(commentText)));
+        if (c.isReply()) c.reparent(newSlot[c.getParentSlot()]);
+    }
+    commentText = move(packed);
+
+    // Dropping tombstones from the slot lists keeps the survivors in order
+    auto remap = [&](vector<uint32_t>& slots) {
+        size_t pos = 0;
+        for (uint32_t slot : slots) {
+            if (newSlot[slot] != gone) slots[pos++] = newSlot[slot];
+        }
+        slots.resize(pos);
+    };
+    remap(topLevel);
+    remap(byLikes);
+    likeRank.assign(kept, NOT_RANKED);
+    for (size_t pos = 0; pos < byLikes.size(); ++pos) {
+        likeRank[byLikes[pos]] = static_cast<uint32_t>(pos);
+    }
+
+    unordered_map<uint32_t, vector<uint32_t>> threads;
+    for (auto& entry : replySlots) {
+        if (newSlot[entry.first] == gone) continue;
+        remap(entry.second);
+        if (!entry.second.empty()) threads[newSlot[entry.first]] = move(entry.second);
+    }
+    replySlots = move(threads);
+    removedComments = 0;
+}
+
+void Video::promote(size_t slot, int delta) {
+    // Swap with the first comment sharing this like count; everything before
+    // that one has more likes, so the order still holds after the increment.
+    // A bigger jump repeats that with the head of each group it overtakes,
+    // so the cost follows the number of groups passed, not comments.
+    int target = comments[slot].getLikes() + delta;
+    int group = comments[slot].getLikes();
+    size_t pos = likeRank[slot];
+    while (true) {
+        auto first = lower_bound(byLikes.begin(), byLikes.begin() + pos, group,
+            [this](uint32_t s, int l) { return comments[s].getLikes() > l; });
+        size_t head = first - byLikes.begin();
+        if (head != pos) {
+            swap(byLikes[head], byLikes[pos]);
+            likeRank[byLikes[head]] = static_cast<uint32_t>(head);
+            likeRank[byLikes[pos]] = static_cast<uint32_t>(pos);
+            pos = head;
+        }
+        if (pos == 0) return;
+        group = comments[byLikes[pos - 1]].getLikes();
+        if (group >= target) return;
+    }
+}
+
+void Video::demote(size_t slot, int delta) {
+    // Mirror of promote: swap with the last comment of each group it drops below
+    int target = comments[slot].getLikes() - delta;
+    int group = comments[slot].getLikes();
+    size_t pos = likeRank[slot];
+    while (true) {
+        auto end = partition_point(byLikes.begin() + pos + 1, byLikes.end(),
+            [this, group](uint32_t s) { return comments[s].getLikes() >= group; });
+        size_t tail = (end - byLikes.begin()) - 1;
+        if (tail != pos) {
+            swap(byLikes[tail], byLikes[pos]);
+            likeRank[byLikes[tail]] = static_cast<uint32_t>(tail);
+            likeRank[byLikes[pos]] = static_cast<uint32_t>(pos);
+            pos = tail;
+        }
+        if (pos + 1 == byLikes.size()) return;
+        group = comments[byLikes[pos + 1]].getLikes();
+        if (group <= target) return;
+    }
+}
+
+OpResult Video::pageOf(const vector<uint32_t>& slots, long long cursor, size_t limit,
+                       vector<const Comment*>& page) const {
+    page.clear();
+    size_t pos = 0;
+    if (cursor > 0) {
+        auto it = commentSlots.find(CommentId(cursor));
+        if (it == commentSlots.end()) return OpResult(OpStatus::NOT_FOUND, "Cursor expired, start again");
+        // Slot lists are ascending, so the cursor's place is a binary search away
+        pos = upper_bound(slots.begin(), slots.end(), it->second) - slots.begin();
+    }
+
+    // Only walks as far as this page needs, however long the thread is
+    for (; pos < slots.size() && page.size() < limit; ++pos) {
+        if (!comments[slots[pos]].isRemoved()) page.push_back(&comments[slots[pos]]);
+    }
+
+    // The next page resumes after the last comment handed out
+    bool more = false;
+    for (size_t i = pos; i < slots.size(); ++i) {
+        if (!comments[slots[i]].isRemoved()) { more = true; break; }
+    }
+    long long next = (more && !page.empty()) ? page.back()->getId().value() : -1;
+    return OpResult(OpStatus::SUCCESS, to_string(page.size()) + " comments", next);
+}
+
+OpResult Video::commentsPage(long long cursor, size_t limit, vector<const Comment*>& page) const {
+    return pageOf(topLevel, cursor, limit, page);
+}
+
+OpResult Video::repliesPage(CommentId parentId, long long cursor, size_t limit,
+                            vector<const Comment*>& page) const {
+    uint32_t parentSlot;
+    if (!liveComment(parentId, &parentSlot)) {
+        page.clear();
+        return OpResult(OpStatus::NOT_FOUND, "Comment not found");
+    }
+    auto it = replySlots.find(parentSlot);
+    if (it == replySlots.end()) {
+        page.clear();
+        return OpResult(OpStatus::SUCCESS, "0 comments");
+    }
+    return pageOf(it->second, cursor, limit, page);
+}
+
+void Video::printComments(const vector<const Comment*>& page, const string& indent) const {
+    for (const Comment* c : page) {
+        cout << indent << "[" << c->getId() << "] " << c->getAuthor() 
+             << " (" << c->getLikes() << " likes): " << textOf(*c);
+        if (c->getReplyCount() > 0) {
+            cout << " [" << c->getReplyCount() << (c->getReplyCount() == 1 ? " reply]" : " replies]");
+        }
+        cout << "\n";
+    }
+}
+
+OpResult Video::listComments(long long cursor, size_t limit) const {
+    vector<const Comment*> page;
+    OpResult result = commentsPage(cursor, limit, page);
+    if (!result.isSuccess()) return result;
+
+    if (cursor <= 0) {
+        if (page.empty()) {
+            cout << "No comments\n";
+            return result;
+        }
+        cout << "Comments for \"" << title << "\":\n";
+    }
+    printComments(page, "  ");
+    return result;
+}
+
+OpResult Video::listReplies(CommentId parentId, long long cursor, size_t limit) const {
+    vector<const Comment*> page;
+    OpResult result = repliesPage(parentId, cursor, limit, page);
+    if (!result.isSuccess()) return result;
+
+    if (cursor <= 0) {
+        if (page.empty()) {
+            cout << "No replies\n";
+            return result;
+        }
+        cout << "Replies to comment " << parentId << ":\n";
+    }
+    printComments(page, "    ");
+    return result;
+}
+
+vector<const Comment*> Video::topComments(size_t n) const {
+    vector<const Comment*> out;
+    for (size_t i = 0; i < byLikes.size() && out.size() < n; ++i) {
+        const Comment& c = comments[byLikes[i]];
+        if (!c.isRemoved()) out.push_back(&c);
+    }
+    return out;
+}
+
+void Video::listTopComments(size_t n) const {
+    vector<const Comment*> top = topComments(n);
+    if (top.empty()) {
         cout << "No comments\n";
         return;
     }
-    cout << "Comments for \"" << title << "\":\n";
-    for (const auto &c : comments) {
-        cout << "  [" << c.getId() << "] " << c.getAuthor() 
-             << " (" << c.getLikes() << " likes): " << c.getText() << "\n";
+    cout << "Top comments for \"" << title << "\":\n";
+    printComments(top, "  ");
+}
+
+string_view Video::textOf(const Comment& c) const { return c.getText(commentText); }
+
+CommentMemory Video::commentMemory() const {
+    CommentMemory m;
+    m.slots = comments.size();
+    m.live = comments.size() - removedComments;
+    m.recordBytes = comments.capacity() * sizeof(Comment);
+    m.textBytes = commentText.bytesReserved();
+    // One bucket pointer per bucket plus a node (next pointer + key/value) per entry
+    m.indexBytes = commentSlots.bucket_count() * sizeof(void*) +
+                   commentSlots.size() * (sizeof(void*) + sizeof(pair<const CommentId, uint32_t>));
+    m.rankingBytes = (byLikes.capacity() + likeRank.capacity()) * sizeof(uint32_t);
+    m.threadBytes = topLevel.capacity() * sizeof(uint32_t) + replySlots.bucket_count() * sizeof(void*);
+    for (const auto& entry : replySlots) {
+        m.threadBytes += sizeof(void*) + sizeof(entry) + entry.second.capacity() * sizeof(uint32_t);
+    }
+    return m;
+}
+
+size_t applyLikeBatch(vector<LikeEvent> events, const VideoTable& videos) {
+    PerfTimer timer("applyLikeBatch", PERF_LOGGING);
+
+    // Sorting by video gives each one a contiguous run to apply in one call
+    stable_sort(events.begin(), events.end(),
+        [](const LikeEvent& a, const LikeEvent& b) { return a.videoId < b.videoId; });
+    size_t applied = 0;
+    for (size_t i = 0; i < events.size();) {
+        size_t j = i;
+        while (j < events.size() && events[j].videoId == events[i].videoId) ++j;
+        Video* v = videos.find(events[i].videoId);
+        if (v) applied += v->applyLikes(&events[i], j - i);
+        i = j;
+    }
+    return applied;
+}
+
+// VideoTable implementation
+bool VideoTable::insert(Video* v) {
+    VideoId id = v->getId();
+    long long idChunkStart = id.value() & ~static_cast<long long>(CHUNK_SIZE - 1);
+    if (base < 0) base = idChunkStart;
+    if (!sparse.empty() && sparse.count(id)) return false;
+
+    // IDs a little below the range (out-of-order uploads) extend it downwards
+    bool grew = false;
+    if (id.value() < base && static_cast<size_t>((base - idChunkStart) >> CHUNK_BITS) <= MAX_CHUNK_GAP) {
+        vector<unique_ptr<Video*[]>> grown(static_cast<size_t>((base - idChunkStart) >> CHUNK_BITS));
+        for (auto& chunk : chunks) grown.push_back(move(chunk));
+        chunks.swap(grown);
+        base = idChunkStart;
+        grew = true;
     }
+
+    if (id.value() >= base) {
+        size_t offset = static_cast<size_t>(id.value() - base);
+        size_t chunk = offset >> CHUNK_BITS;
+        if (chunk < chunks.size() + MAX_CHUNK_GAP) {
+            if (chunk >= chunks.size()) {
+                chunks.resize(chunk + 1);
+                grew = true;
+            }
+            if (!chunks[chunk]) chunks[chunk] = make_unique<Video*[]>(CHUNK_SIZE);  // Zeroed
+            Video*& slot = chunks[chunk][offset & (CHUNK_SIZE - 1)];
+            if (slot) return false;
+            slot = v;
+            ++count;
+            if (grew) absorbSparse();
+            return true;
+        }
+    }
+    if (!sparse.emplace(id, v).second) return false;
+    ++count;
+    return true;
 }
 
+void VideoTable::absorbSparse() {
+    long long end = base + static_cast<long long>(chunks.size() * CHUNK_SIZE);
+    for (auto it = sparse.begin(); it != sparse.end();) {
+        long long id = it->first.value();
+        if (id < base || id >= end) {
+            ++it;
+            continue;
+        }
+        size_t offset = static_cast<size_t>(id - base);
+        auto& chunk = chunks[offset >> CHUNK_BITS];
+        if (!chunk) chunk = make_unique<Video*[]>(CHUNK_SIZE);
+        chunk[offset & (CHUNK_SIZE - 1)] = it->second;
+        it = sparse.erase(it);
+    }
+}
+
+Video* VideoTable::find(VideoId id) const {
+    if (base >= 0 && id.value() >= base) {
+        size_t offset = static_cast<size_t>(id.value() - base);
+        size_t chunk = offset >> CHUNK_BITS;
+        // Growing the range absorbs sparse IDs it covers, so a miss here is final
+        if (chunk < chunks.size()) return chunks[chunk] ? chunks[chunk][offset & (CHUNK_SIZE - 1)] : nullptr;
+    }
+    if (sparse.empty()) return nullptr;
+    auto it = sparse.find(id);
+    return it != sparse.end() ? it->second : nullptr;
+}
+
+Video* VideoTable::first() const {
+    for (const auto& chunk : chunks) {
+        if (!chunk) continue;
+        for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+            if (chunk[i]) return chunk[i];
+        }
+    }
+    return sparse.empty() ? nullptr : sparse.begin()->second;
+}
+
+size_t VideoTable::size() const { return count; }
+bool VideoTable::empty() const { return count == 0; }
+size_t VideoTable::sparseSize() const { return sparse.size(); }
+
 // Channel implementation
 Channel::Channel() = default;
 
@@ -156,7 +790,9 @@ Video* Channel::upload(const string& title, int dur) {
     auto v = make_unique<Video>(title, name, dur);
     Video* ptr = v.get();
     uploads.push_back(move(v));
-    Logger::info("Uploaded \"" + title + "\" (id=" + to_string(ptr->getId()) + 
+    SEARCH_INDEX.add(ptr);
+    TRENDING.add(ptr);
+    Logger::info("Uploaded \"" + title + "\" (id=" + to_string(ptr->getId().value()) + 
                  ") to channel " + name);
     return ptr;
 }
@@ -175,41 +811,71 @@ OpResult Channel::unsubscribe(const string& user) {
     return OpResult(OpStatus::NOT_FOUND, user + " was not subscribed");
 }
 
+long long Channel::getUniqueViewers() const {
+    HyperLogLog audience;
+    for (const auto& v : uploads) {
+        if (v->viewerSketch()) audience.merge(*v->viewerSketch());
+    }
+    return audience.estimate();
+}
+
+long long Channel::getViewsInLast(ViewTimeline::Resolution r, size_t n) const {
+    long long total = 0;
+    for (const auto& v : uploads) total += v->getViewsInLast(r, n);
+    return total;
+}
+
 void Channel::listUploads() const {
     if (uploads.empty()) {
         cout << "No uploads\n";
         return;
     }
-    cout << "Uploads for channel " << name << ":\n";
+    cout << "Uploads for channel " << name << " (~" << getUniqueViewers() << " unique viewers):\n";
     for (const auto &v : uploads) {
         cout << "  [" << v->getId() << "] " << v->getTitle() 
-             << " (views: " << v->getViews() << ")\n";
+             << " (views: " << v->getViews() << ", ~" << v->getUniqueViewers() << " unique)\n";
+    }
+}
+
+void Channel::listRecentViews() const {
+    auto line = [](long long hour, long long day, long long month) {
+        return "last hour " + to_string(hour) + ", last day " + to_string(day) +
+               ", last 30 days " + to_string(month);
+    };
+    cout << "Recent views for channel " << name << ": "
+         << line(getViewsInLast(ViewTimeline::MINUTE, 60), getViewsInLast(ViewTimeline::HOUR, 24),
+                 getViewsInLast(ViewTimeline::DAY, 30)) << "\n";
+    for (const auto& v : uploads) {
+        cout << "  [" << v->getId() << "] " << v->getTitle() << ": "
+             << line(v->getViewsInLast(ViewTimeline::MINUTE, 60), v->getViewsInLast(ViewTimeline::HOUR, 24),
+                     v->getViewsInLast(ViewTimeline::DAY, 30)) << "\n";
     }
 }
 
 // Playlist implementation
 Playlist::Playlist() = default;
-Playlist::Playlist(const string& n): name(n) {}
+Playlist::Playlist(const string& n): id(IdGen::next<PlaylistId>()), name(n) {}
 
-void Playlist::add(long long videoId, const string& videoTitle) {
+void Playlist::add(VideoId videoId, const string& videoTitle) {
     videoIds.push_back(videoId);
     Logger::info("Added \"" + videoTitle + "\" to playlist \"" + name + "\"");
 }
 
-const vector<long long>& Playlist::getVideoIds() const { return videoIds; }
+PlaylistId Playlist::getId() const { return id; }
+const vector<VideoId>& Playlist::getVideoIds() const { return videoIds; }
 const string& Playlist::getName() const { return name; }
 
-void Playlist::show(const unordered_map<long long, Video*>& videoMap) const {
+void Playlist::show(const VideoTable& videos) const {
     cout << "Playlist: " << name << "\n";
     if (videoIds.empty()) {
         cout << "  (empty)\n";
         return;
     }
     for (size_t i = 0; i < videoIds.size(); ++i) {
-        auto it = videoMap.find(videoIds[i]);
-        if (it != videoMap.end()) {
-            cout << "  [" << (i+1) << "] " << it->second->getTitle() 
-                 << " (id=" << it->second->getId() << ")\n";
+        Video* v = videos.find(videoIds[i]);
+        if (v) {
+            cout << "  [" << (i+1) << "] " << v->getTitle() 
+                 << " (id=" << v->getId() << ")\n";
         }
     }
 }
@@ -1,6 +1,7 @@
 #ifndef VIDEO_H
 #define VIDEO_H
 
+#include "analytics.h"
 #include <iostream>
 #include <string>
 #include <vector>
@@ -10,6 +11,9 @@
 #include <algorithm>
 #include <chrono>
 #include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <mutex>
 
 using namespace std;
 
@@ -47,12 +51,119 @@ public:
 // Toggle this to see performance measurements
 extern bool PERF_LOGGING;
 
-// Thread-safe ID generator using atomic operations
+// Puts item into a best-first list of at most limit entries after its score grew.
+// Scores never drop, so an entry only ever moves towards the front.
+template <typename T, typename Same, typename Score>
+void offerMonotone(vector<T>& top, size_t limit, const T& item, Same same, Score score) {
+    auto it = find_if(top.begin(), top.end(), [&](const T& e) { return same(e, item); });
+    if (it != top.end()) {
+        *it = item;
+    } else if (top.size() < limit) {
+        top.push_back(item);
+        it = top.end() - 1;
+    } else if (score(item) > score(top.back())) {
+        top.back() = item;
+        it = top.end() - 1;
+    } else {
+        return;
+    }
+    while (it != top.begin() && score(*(it - 1)) < score(*it)) {
+        iter_swap(it - 1, it);
+        --it;
+    }
+}
+
+// Kinds of entity that get IDs; each one counts in its own ID space
+enum class IdKind { VIDEO, COMMENT, SESSION, PLAYLIST };
+
+// An ID tagged with its kind. It only converts to and from the raw number
+// explicitly, so a comment ID can't be passed where a video ID is expected.
+// Same size as the number it wraps.
+template <IdKind K>
+class TypedId {
+private:
+    long long raw;
+public:
+    static constexpr IdKind KIND = K;
+
+    constexpr TypedId() : raw(-1) {}  // Refers to nothing
+    constexpr explicit TypedId(long long value) : raw(value) {}
+    constexpr long long value() const { return raw; }
+    constexpr bool valid() const { return raw > 0; }
+
+    constexpr bool operator==(TypedId o) const { return raw == o.raw; }
+    constexpr bool operator!=(TypedId o) const { return raw != o.raw; }
+    constexpr bool operator<(TypedId o) const { return raw < o.raw; }
+    constexpr bool operator>(TypedId o) const { return raw > o.raw; }
+    constexpr bool operator<=(TypedId o) const { return raw <= o.raw; }
+    constexpr bool operator>=(TypedId o) const { return raw >= o.raw; }
+};
+
+template <IdKind K>
+ostream& operator<<(ostream& os, TypedId<K> id) { return os << id.value(); }
+
+using VideoId = TypedId<IdKind::VIDEO>;
+using CommentId = TypedId<IdKind::COMMENT>;
+using SessionId = TypedId<IdKind::SESSION>;
+using PlaylistId = TypedId<IdKind::PLAYLIST>;
+
+namespace std {
+template <IdKind K>
+struct hash<TypedId<K>> {
+    size_t operator()(TypedId<K> id) const noexcept { return hash<long long>()(id.value()); }
+};
+}
+
+// Snowflake IDs (milliseconds, node, sequence) that merge across simulation nodes
+class SnowflakeGen {
+private:
+    long long node;
+    alignas(64) atomic<long long> last{0};  // Timestamp and sequence of the newest ID
+
+public:
+    static constexpr int NODE_BITS = 10;
+    static constexpr int SEQUENCE_BITS = 12;
+    static constexpr long long MAX_NODE = (1LL << NODE_BITS) - 1;
+    static constexpr long long EPOCH_MS = 1704067200000LL;  // 2024-01-01 UTC
+
+    explicit SnowflakeGen(long long nodeId);
+
+    // One CAS, no locks; always higher than every ID handed out before. Past
+    // 4096 IDs in a millisecond it borrows the next one instead of waiting.
+    long long next();
+
+    // The parts of a snowflake ID; the timestamp is Unix milliseconds
+    static long long timestampOf(long long id);
+    static long long nodeOf(long long id);
+    static long long sequenceOf(long long id);
+};
+
+// Thread-safe ID generators, one counter per kind so video IDs stay dense
 class IdGen {
 private:
-    static atomic<long long> counter;
+    static constexpr size_t KINDS = 4;
+    struct alignas(64) Counter {  // One cache line per kind
+        atomic<long long> value{0};
+    };
+    static Counter counters[KINDS];
+    static unique_ptr<SnowflakeGen> snowflakes[KINDS];  // Set in snowflake mode
+
 public:
-    static long long next();
+    // IDs a thread reserves from the shared counter at once and hands out locally
+    static constexpr long long BLOCK_SIZE = 64;
+
+    // Switches videos, comments and playlists to snowflake IDs from this node.
+    // Sessions keep counting, since their IDs pack a slot and never leave the
+    // process. Call at startup, before any ID is handed out or a thread starts.
+    static OpResult useSnowflake(long long node);
+    static bool snowflakeMode();
+
+    // Increasing per thread, but threads interleave by block, so a higher ID
+    // doesn't mean the object was created later
+    static long long next(IdKind kind);
+    // IdGen::next<VideoId>() and so on
+    template <typename Id>
+    static Id next() { return Id(next(Id::KIND)); }
 };
 
 // Centralized logging to keep output consistent
@@ -66,53 +177,268 @@ public:
     static void error(const string& msg);
 };
 
-// Represents a comment on a video with likes and timestamp
+// Interns comment author names into 32-bit handles; only intern() locks
+class AuthorPool {
+private:
+    static const size_t CHUNK_BITS = 16;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static atomic<string*> chunks[size_t(1) << (32 - CHUNK_BITS)];  // Never move, so name() reads unlocked
+    static atomic<uint32_t> count;
+    static unordered_map<string_view, uint32_t> handles;
+    static mutex lock;
+public:
+    static uint32_t intern(const string& name);
+    static const string& name(uint32_t handle);
+    static size_t size();
+};
+
+// Bump allocator for one video's comment text, in blocks that never move
+class TextArena {
+private:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    vector<unique_ptr<char[]>> blocks;
+    vector<char*> windows;  // BLOCK_SIZE-wide offset window -> its bytes
+    size_t used = 0;        // Next free offset
+    size_t stored = 0;      // Text bytes copied in, excluding block tails left unused
+public:
+    // Copies the text in and returns its offset; text never straddles two blocks
+    uint32_t append(string_view text);
+    string_view view(uint32_t offset, uint32_t length) const;
+    size_t bytesUsed() const;
+    size_t bytesReserved() const;
+};
+
+// Represents a comment on a video with likes and timestamp, packed into 40 bytes
 class Comment {
 private:
-    long long id;
-    string author;
-    string text;
+    static const uint32_t REMOVED_BIT = 0x80000000u;  // Tombstone flag in textLength
+
+    CommentId id;
+    uint32_t author;      // AuthorPool handle
+    uint32_t textOffset;  // Into the owning video's TextArena
+    uint32_t textLength;
     int likes;
-    long long ts;
+    uint32_t tsDelta;     // Seconds after the video was created
+    uint32_t parent;      // Slot of the comment this replies to, or NO_PARENT
+    uint32_t replies;     // Live direct replies
+    atomic<uint32_t> pending;  // Concurrent likes not yet folded into likes
 public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
     Comment();
-    Comment(const string& a, const string& t);
+    Comment(uint32_t authorHandle, uint32_t offset, uint32_t length, uint32_t secondsAfterVideo,
+            uint32_t parentSlot = NO_PARENT);
+    // Copies are only made while no thread is liking (vector growth, compaction)
+    Comment(const Comment& other);
+    Comment& operator=(const Comment& other);
 
-    long long getId() const;
+    CommentId getId() const;
     const string& getAuthor() const;
-    const string& getText() const;
+    string_view getText(const TextArena& arena) const;
+    uint32_t getTextOffset() const;
+    uint32_t getTextLength() const;
+    long long getTimestamp(long long videoCreatedMs) const;
+    // Folded count, which is what the like ranking is ordered by
     int getLikes() const;
+    // Folded count plus concurrent likes still pending
+    int getLikesExact() const;
+    uint32_t getPendingLikes() const;
     void like();
+    // Safe from any number of threads at once; lands in the ranking on fold
+    void likeConcurrent();
+    // Clears the pending likes and returns how many there were
+    uint32_t takePending();
+    void addLikes(int delta);
+    bool isRemoved() const;
+    void markRemoved();
+    void relocateText(uint32_t offset);
+
+    bool isReply() const;
+    uint32_t getParentSlot() const;
+    void reparent(uint32_t slot);
+    uint32_t getReplyCount() const;
+    void replyAdded();
+    void replyRemoved();
+};
+
+// Bytes a video spends on its comments (hash index is an estimate)
+struct CommentMemory {
+    size_t slots = 0;         // Records, tombstones included
+    size_t live = 0;
+    size_t recordBytes = 0;   // Comment records
+    size_t textBytes = 0;     // Arena blocks
+    size_t indexBytes = 0;    // ID -> slot hash index
+    size_t rankingBytes = 0;  // Like ordering
+    size_t threadBytes = 0;   // Top-level list and reply lists
+    size_t total() const;
+};
+
+// One like (delta 1) or unlike (delta -1) from an ingest batch; bigger deltas
+// are allowed for pre-aggregated counts
+struct LikeEvent {
+    VideoId videoId;
+    CommentId commentId;
+    int delta;
 };
 
 // Video class handles playback, views, and comments
 class Video {
 private:
-    long long id;
+    VideoId id;
     string title;
     string uploader;
     int durationSec;
-    long long views;
-    bool playing;
-    vector<Comment> comments;
+    StripedCounter views;  // Bumped from any thread that records a view
+    unique_ptr<HyperLogLog> viewers;  // Created on the first signed-in watch
+    // Fed from views in batches by foldViews, so recordView never touches it
+    mutable ViewTimeline recentViews;
+    mutable atomic<long long> timelineViews{0};  // Views already credited to recentViews
+    long long createdMs;  // Comment timestamps are stored relative to this
+    vector<Comment> comments;                       // Insertion order, tombstones included
+    TextArena commentText;
+    unordered_map<CommentId, uint32_t> commentSlots;  // Comment ID -> index in comments
+    size_t removedComments = 0;
+    vector<uint32_t> topLevel;  // Slots of comments that aren't replies, in order
+    // Parent slot -> its reply slots in order. A list only exists once the
+    // comment gets its first reply, so reply-less comments cost nothing here.
+    unordered_map<uint32_t, vector<uint32_t>> replySlots;
+    // Top-level slots ordered by likes, most liked first. A like only moves a comment
+    // past the comments that had the same count, so the order never needs a full sort.
+    vector<uint32_t> byLikes;
+    vector<uint32_t> likeRank;  // Slot -> position in byLikes, NOT_RANKED for replies
+
+    static constexpr uint32_t NOT_RANKED = UINT32_MAX;
+
+    // Credits views counted since the last fold to the current minute
+    void foldViews() const;
+
+    uint32_t storeComment(uint32_t author, const string& text, uint32_t parentSlot);
+    const Comment* liveComment(CommentId cid, uint32_t* slot = nullptr) const;
+    size_t removeThread(uint32_t slot);
+    void compactComments();
+    // Moves a ranked comment up to where it belongs once it has delta more likes
+    void promote(size_t slot, int delta = 1);
+    // Same downwards, for delta fewer likes
+    void demote(size_t slot, int delta);
+    // Applies per-slot like changes (one entry per slot) and fixes the ranking
+    void adjustLikes(const vector<pair<uint32_t, int>>& deltas);
+    // Shared by top-level and reply paging: slots is an ascending slot list
+    OpResult pageOf(const vector<uint32_t>& slots, long long cursor, size_t limit,
+                    vector<const Comment*>& page) const;
+    void printComments(const vector<const Comment*>& page, const string& indent) const;
 
 public:
+    // Compact once at least this many tombstones make up half the comments
+    static const size_t COMPACT_MIN_REMOVED = 64;
+    static const size_t COMMENT_PAGE_SIZE = 20;
+    // A fold or batch re-sorts the ranking once more than 1/RESORT_FRACTION of it changed
+    static const size_t RESORT_FRACTION = 16;
+
     Video();
     Video(const string& t, const string& u, int d);
+    // Takes a caller-chosen ID, e.g. for benchmark fixtures that must not use up real IDs
+    Video(VideoId vid, const string& t, const string& u, int d);
 
-    long long getId() const;
+    VideoId getId() const;
     const string& getTitle() const;
     const string& getUploader() const;
     long long getViews() const;
+    // Distinct signed-in viewers, estimated; 0 before anyone watched
+    long long getUniqueViewers() const;
+    const HyperLogLog* viewerSketch() const;
+    // Views in the last n minutes, hours or days (current period included)
+    long long getViewsInLast(ViewTimeline::Resolution r, size_t n) const;
+    int getDuration() const;
 
+    // Counts a view and refreshes autocomplete and trending. Playback state lives in
+    // sessions (see SessionPool), so any number of viewers can be playing.
     OpResult play();
-    OpResult pause();
+    // Counts one view; safe from any number of threads at once. Unlike play()
+    // it leaves the autocomplete ranking and the view timeline alone; both
+    // catch up on the video's next play(), and the timeline on any read too.
+    void recordView();
+    void recordViewer(const string& user);
     OpResult addComment(const string& user, const string& text);
-    OpResult likeComment(long long cid);
-    OpResult removeComment(long long cid, const string& requester, const string& channelOwner);
-    void listComments() const;
+    OpResult addReply(const string& user, CommentId parentId, const string& text);
+    // Same, for callers that already hold the author's AuthorPool handle
+    OpResult addComment(uint32_t author, const string& text);
+    OpResult addReply(uint32_t author, CommentId parentId, const string& text);
+    OpResult likeComment(CommentId cid);
+    // Lock-free like for many threads at once. Only other concurrent likes and
+    // reads may run alongside it; rankings catch up on the next foldLikes().
+    OpResult likeCommentConcurrent(CommentId cid);
+    // Applies pending concurrent likes to the ranking; returns how many there were
+    size_t foldLikes();
+    // Applies a batch of like changes for this video in one pass; deltas may be
+    // negative (unlikes) and counts stop at zero. Returns the events that matched
+    // a live comment; the rest are skipped.
+    size_t applyLikes(const LikeEvent* events, size_t count);
+    // Removing a comment also removes every reply below it
+    OpResult removeComment(CommentId cid, const string& requester, const string& channelOwner);
+    // Up to `limit` live top-level comments after the one `cursor` points at
+    // (0 = from the start). The result id is the cursor for the next page, -1
+    // at the end; callers should treat it as opaque. Replies are never read.
+    OpResult commentsPage(long long cursor, size_t limit, vector<const Comment*>& page) const;
+    OpResult listComments(long long cursor = 0, size_t limit = COMMENT_PAGE_SIZE) const;
+    // Same paging over the direct replies to one comment
+    OpResult repliesPage(CommentId parentId, long long cursor, size_t limit, vector<const Comment*>& page) const;
+    OpResult listReplies(CommentId parentId, long long cursor = 0, size_t limit = COMMENT_PAGE_SIZE) const;
+    // Most liked live top-level comments first, reading only as far as needed.
+    // Concurrent likes only count once folded.
+    vector<const Comment*> topComments(size_t n) const;
+    void listTopComments(size_t n) const;
+    string_view textOf(const Comment& c) const;
+    CommentMemory commentMemory() const;
 };
 
+// Registry of videos by ID, in chunks indexed by (id - base) instead of a hash map
+class VideoTable {
+private:
+    static const size_t CHUNK_BITS = 10;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    // IDs more than this many chunks beyond either end of the dense range go sparse
+    static const size_t MAX_CHUNK_GAP = 64;
+
+    long long base = -1;  // ID stored at offset 0, chunk-aligned; set by the first insert
+    vector<unique_ptr<Video*[]>> chunks;  // Never move; empty ranges get no chunk
+    // IDs too far from the dense range, e.g. every video in snowflake mode
+    unordered_map<VideoId, Video*> sparse;
+    size_t count = 0;
+
+    // Moves sparse videos whose IDs the dense range now covers into it
+    void absorbSparse();
+
+public:
+    // Returns false if the ID is already taken
+    bool insert(Video* v);
+    // Null when no video has the ID
+    Video* find(VideoId id) const;
+    // Lowest-ID video of the dense range (any video if all are sparse), null when empty
+    Video* first() const;
+    size_t size() const;
+    bool empty() const;
+    size_t sparseSize() const;
+
+    // Calls fn(Video*) for every video, dense range in ID order first
+    template <typename Fn>
+    void forEach(Fn&& fn) const;
+};
+
+template <typename Fn>
+void VideoTable::forEach(Fn&& fn) const {
+    for (const auto& chunk : chunks) {
+        if (!chunk) continue;
+        for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+            if (chunk[i]) fn(chunk[i]);
+        }
+    }
+    for (const auto& entry : sparse) fn(entry.second);
+}
+
+// Groups a batch of like events by video and applies each group in one pass.
+// Returns how many events were applied; unknown videos and comments are skipped.
+size_t applyLikeBatch(vector<LikeEvent> events, const VideoTable& videos);
+
 // Channel owns videos and manages subscribers
 class Channel {
 private:
@@ -136,23 +462,30 @@ public:
     Video* upload(const string& title, int dur);
     OpResult subscribe(const string& user);
     OpResult unsubscribe(const string& user);
+    // Distinct viewers across all uploads; someone who watched several
+    // of them is counted once
+    long long getUniqueViewers() const;
+    long long getViewsInLast(ViewTimeline::Resolution r, size_t n) const;
     void listUploads() const;
+    void listRecentViews() const;
 };
 
 // Playlist stores video IDs instead of pointers to avoid ownership issues
 class Playlist {
 private:
+    PlaylistId id;
     string name;
-    vector<long long> videoIds;
+    vector<VideoId> videoIds;
 
 public:
     Playlist();
     Playlist(const string& n);
 
-    void add(long long videoId, const string& videoTitle);
-    const vector<long long>& getVideoIds() const;
+    PlaylistId getId() const;
+    void add(VideoId videoId, const string& videoTitle);
+    const vector<VideoId>& getVideoIds() const;
     const string& getName() const;
-    void show(const unordered_map<long long, Video*>& videoMap) const;
+    void show(const VideoTable& videos) const;
 };
 
 #endif